@@ -178,6 +178,23 @@ namespace PorterStemmer
 		},
 	};
 	inline constexpr std::size_t steps_cnt = sizeof(steps) / sizeof(*steps);
+
+	// Byte-level normalization which can be prepended to the steps (see BimachineCascade::prepend): uppercase letters are lowercased,
+	// and digits and punctuation become spaces, so they separate words. Symbols with a special meaning in regular expressions are not included.
+	inline const std::string uppercase = "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+		separators = "0123456789.;:!?\"'-/",
+		normalization_alphabet = alphabet + uppercase + separators;
+	inline const std::vector<ContextualReplacementRule> normalization = {
+		{[] {
+			std::string center = "(";
+			for(char upper : uppercase)
+				center += "["s + upper + ',' + static_cast<char>(upper - 'A' + 'a') + "]|";
+			for(char separator : separators)
+				center += "["s + separator + ", ]|";
+			center.back() = ')';
+			return center;
+		}(), eps, eps},
+	};
 }
 
 #endif
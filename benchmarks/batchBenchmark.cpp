@@ -0,0 +1,167 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include <span>
+#include "compiledBimachine.hpp"
+#include "PorterStemmer.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp batchBenchmark.cpp
+// reads text from stdin, splits it into tokens (a word followed by one whitespace symbol) and stems every token independently
+
+using Clock = std::chrono::steady_clock;
+
+// every token ends right after a whitespace symbol (or at the end of the text)
+std::vector<std::size_t> tokenize(std::string_view text)
+{
+	std::vector<std::size_t> offsets{0};
+	for(std::size_t i = 0; i < text.size(); i++)
+		if(PorterStemmer::whitespace.find(text[i]) != std::string::npos)
+			offsets.push_back(i + 1);
+	if(offsets.back() != text.size())
+		offsets.push_back(text.size());
+	return offsets;
+}
+
+void report(const char* mode, std::size_t tokens, Clock::duration elapsed)
+{
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	std::cerr << mode << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed) << ", " << static_cast<std::size_t>(tokens / seconds) << " tokens/s\n";
+}
+
+int main() try
+{
+	std::vector<CompiledBimachineWithFinalOutput> bm;
+	for(std::size_t i = 0; i < PorterStemmer::steps_cnt; i++)
+	{
+		std::vector<ContextualReplacementRuleRepresentation> batch;
+		for(const auto& rule : PorterStemmer::steps[i])
+			batch.emplace_back(rule, PorterStemmer::alphabet);
+		bm.emplace_back(std::move(batch));
+	}
+	std::string text;
+	std::getline(std::cin, text, '\0');
+	const std::vector<std::size_t> offsets = tokenize(text);
+	const std::size_t tokens = offsets.size() - 1;
+	std::cerr << "tokens: " << tokens << '\n';
+
+	std::vector<Word> per_call_results;
+	{
+		auto start = Clock::now();
+		per_call_results.reserve(tokens);
+		for(std::size_t t = 0; t < tokens; t++)
+		{
+			Word token = text.substr(offsets[t], offsets[t + 1] - offsets[t]);
+			for(const auto& step : bm)
+				token = step(token);
+			per_call_results.push_back(std::move(token));
+		}
+		report("per call", tokens, Clock::now() - start);
+	}
+	{
+		auto start = Clock::now();
+		Word curr, next;
+		std::vector<State> right_path;
+		for(std::size_t t = 0; t < tokens; t++)
+		{
+			curr.assign(text, offsets[t], offsets[t + 1] - offsets[t]);
+			for(const auto& step : bm)
+			{
+				next.clear();
+				step(curr, next, right_path);
+				std::swap(curr, next);
+			}
+			if(curr != per_call_results[t])
+				throw std::logic_error("per call with a reused sink and scratch gives a different result");
+		}
+		report("per call, reused sink and scratch", tokens, Clock::now() - start);
+	}
+	{
+		auto start = Clock::now();
+		Word inputs = text, results;
+		std::vector<std::size_t> input_offsets = offsets, result_offsets;
+		std::vector<State> right_path;
+		for(const auto& step : bm)
+		{
+			results.clear();
+			step.apply_batch(inputs, input_offsets, results, result_offsets, right_path);
+			std::swap(inputs, results);
+			std::swap(input_offsets, result_offsets);
+		}
+		auto elapsed = Clock::now() - start;
+		for(std::size_t t = 0; t < tokens; t++)
+			if(std::string_view{inputs}.substr(input_offsets[t], input_offsets[t + 1] - input_offsets[t]) != per_call_results[t])
+				throw std::logic_error("batch gives a different result");
+		report("batch", tokens, elapsed);
+	}
+	{
+		// all steps are applied on a few hundred tokens before moving on, so the intermediate results stay in the cache
+		constexpr std::size_t tile = 256;
+		auto start = Clock::now();
+		Word inputs, results, all_results;
+		std::vector<std::size_t> input_offsets, result_offsets, all_offsets{0};
+		std::vector<State> right_path;
+		for(std::size_t first = 0; first < tokens; first += tile)
+		{
+			std::size_t last = std::min(first + tile, tokens);
+			inputs.assign(text, offsets[first], offsets[last] - offsets[first]);
+			input_offsets.clear();
+			for(std::size_t t = first; t <= last; t++)
+				input_offsets.push_back(offsets[t] - offsets[first]);
+			for(const auto& step : bm)
+			{
+				results.clear();
+				step.apply_batch(inputs, input_offsets, results, result_offsets, right_path);
+				std::swap(inputs, results);
+				std::swap(input_offsets, result_offsets);
+			}
+			for(std::size_t t = 1; t < input_offsets.size(); t++)
+				all_offsets.push_back(all_results.size() + input_offsets[t]);
+			all_results += inputs;
+		}
+		auto elapsed = Clock::now() - start;
+		for(std::size_t t = 0; t < tokens; t++)
+			if(std::string_view{all_results}.substr(all_offsets[t], all_offsets[t + 1] - all_offsets[t]) != per_call_results[t])
+				throw std::logic_error("tiled batch gives a different result");
+		report("batch, tiles of 256 tokens", tokens, elapsed);
+	}
+	{
+		// the text is cut at token boundaries into chunks, which are run in lockstep by both automata of each step
+		constexpr std::size_t chunks_cnt = 64;
+		auto start = Clock::now();
+		std::vector<Word> chunks(chunks_cnt), results(chunks_cnt);
+		for(std::size_t i = 0; i < chunks_cnt; i++)
+			chunks[i] = text.substr(offsets[tokens * i / chunks_cnt], offsets[tokens * (i + 1) / chunks_cnt] - offsets[tokens * i / chunks_cnt]);
+		std::vector<std::string_view> inputs(chunks_cnt);
+		std::vector<std::vector<State>> paths;
+		for(const auto& step : bm)
+		{
+			for(std::size_t i = 0; i < chunks_cnt; i++)
+			{
+				inputs[i] = chunks[i];
+				results[i].clear();
+			}
+			step.apply_interleaved(std::span<const std::string_view>(inputs), std::span<Word>(results), paths);
+			std::swap(chunks, results);
+		}
+		auto elapsed = Clock::now() - start;
+		for(std::size_t i = 0; i < chunks_cnt; i++)
+		{
+			Word expected = text.substr(offsets[tokens * i / chunks_cnt], offsets[tokens * (i + 1) / chunks_cnt] - offsets[tokens * i / chunks_cnt]);
+			for(const auto& step : bm)
+				expected = step(expected);
+			if(chunks[i] != expected)
+				throw std::logic_error("interleaved gives a different result");
+		}
+		report("interleaved, 64 chunks", tokens, elapsed);
+	}
+}
+catch(const std::exception& e)
+{
+	std::cerr << e.what() << '\n';
+	return 1;
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstddef>
+#include <stdexcept>
+#include "denseDFA.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp smallDfaBenchmark.cpp
+// runs a random automaton with DenseDFA::SmallStatesCnt states on random input by the dense table, by the packed maps and by findPath,
+// which uses shuffles if the CPU supports them; the dense table is used by the same automaton with one more, unreachable state
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t input_size = 1 << 24, repeats = 5;
+constexpr std::uint32_t columns_cnt = 8;
+
+void report(const char* mode, Clock::duration elapsed)
+{
+	double seconds = std::chrono::duration<double>(elapsed).count() / repeats;
+	std::cerr << mode << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed / repeats) << " per run, " << static_cast<std::size_t>(input_size / seconds / 1e6) << " M symbols/s\n";
+}
+
+int main() try
+{
+	std::mt19937 gen(2024);
+	DenseDFA::ColumnMap columns;
+	columns.fill(Constants::InvalidColumn);
+	for(std::uint32_t column = 0; column < columns_cnt; column++)
+		columns['a' + column] = column;
+	std::vector<State> table(DenseDFA::SmallStatesCnt * columns_cnt);
+	for(State& next : table)
+		next = std::uniform_int_distribution<State>(0, DenseDFA::SmallStatesCnt - 1)(gen);
+	const DenseDFA small(columns, columns_cnt, DenseDFA::SmallStatesCnt, 0, table);
+	table.resize(table.size() + columns_cnt, 0);
+	const DenseDFA large(columns, columns_cnt, DenseDFA::SmallStatesCnt + 1, 0, table);
+	if(!small.small() || large.small())
+		throw std::logic_error("the automata do not have the expected sizes");
+
+	std::string input(input_size, '\0');
+	for(char& c : input)
+		c = 'a' + std::uniform_int_distribution<std::uint32_t>(0, columns_cnt - 1)(gen);
+	std::vector<State> expected, path;
+	{
+		auto start = Clock::now();
+		for(std::size_t r = 0; r < repeats; r++)
+			large.findPath(input, expected);
+		report("dense table", Clock::now() - start);
+	}
+	{
+		auto start = Clock::now();
+		for(std::size_t r = 0; r < repeats; r++)
+			small.withNext([&](auto next) {
+				path.resize(input.size() + 1);
+				State curr = path[0] = small.initial();
+				for(std::size_t i = 0; i < input.size(); i++)
+					path[i + 1] = curr = next(curr, small.column(input[i]));
+			});
+		report("packed maps", Clock::now() - start);
+		if(path != expected)
+			throw std::logic_error("the packed maps give a different path");
+	}
+	{
+		auto start = Clock::now();
+		for(std::size_t r = 0; r < repeats; r++)
+			small.findPath(input, path);
+		report("findPath (shuffles if supported)", Clock::now() - start);
+		if(path != expected)
+			throw std::logic_error("findPath gives a different path");
+	}
+}
+catch(const std::exception& e)
+{
+	std::cerr << e.what() << '\n';
+	return 1;
+}
@@ -0,0 +1,161 @@
+#ifndef BIMACHINECASCADE_HPP
+#define BIMACHINECASCADE_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <chrono>
+#include <utility>
+#include <concepts>
+#include <stdexcept>
+#include "compiledBimachine.hpp"
+#include "bimachineStream.hpp"
+#include "bimachineComposition.hpp"
+#include "editScript.hpp"
+#include "outputSink.hpp"
+#include "constants.hpp"
+
+// A stage which can be applied as a BimachineStream, so that a cascade of such stages can run over tiles of the input.
+template<class Bimachine>
+concept TileableBimachine = std::same_as<Bimachine, CompiledBimachineWithFinalOutput>;
+
+// A sequence of bimachines applied one after another. The intermediate results are kept in two buffers owned by the cascade,
+// which are reused by every application instead of allocating a new string per stage.
+// The time spent in every stage is accumulated over all applications.
+template<class Bimachine>
+class BimachineCascade
+{
+public:
+	using Clock = std::chrono::steady_clock;
+private:
+	std::vector<Bimachine> stages;
+	std::vector<Clock::duration> stage_time;
+	Word buffers[2];
+	std::vector<State> right_path;
+
+	template<class F>
+	void timed(std::size_t stage, F&& f)
+	{
+		auto start = Clock::now();
+		std::forward<F>(f)();
+		stage_time[stage] += Clock::now() - start;
+	}
+public:
+	BimachineCascade() = default;
+	explicit BimachineCascade(std::vector<Bimachine> stages): stages(std::move(stages)), stage_time(this->stages.size()) {}
+
+	template<class... Args>
+	Bimachine& emplace_stage(Args&&... args)
+	{
+		stage_time.emplace_back();
+		return stages.emplace_back(std::forward<Args>(args)...);
+	}
+	// replaces consecutive stages by single bimachines equivalent to them, as long as these stay within limits (see compose_cascade)
+	void compose_stages(const CompositionLimits& limits = {}) requires std::same_as<Bimachine, CompiledBimachineWithFinalOutput>
+	{
+		stages = compose_cascade(stages, limits);
+		reset_timings();
+	}
+	// Composes front into the first stage, so the input is rewritten by front without a pass of its own; e.g. front may normalize the input.
+	// Throws std::length_error and changes nothing if the composition would exceed limits.
+	void prepend(const Bimachine& front, const CompositionLimits& limits = {}) requires std::same_as<Bimachine, CompiledBimachineWithFinalOutput>
+	{
+		if(stages.empty())
+		{
+			emplace_stage(front);
+			return;
+		}
+		auto composed = compose(front, stages.front(), limits);
+		if(!composed)
+			throw std::length_error("the composition with the first stage exceeds the limits");
+		stages.front() = std::move(*composed);
+		reset_timings();
+	}
+	std::size_t size() const noexcept { return stages.size(); }
+	const Bimachine& operator[](std::size_t i) const { return stages[i]; }
+	const std::vector<Bimachine>& Stages() const noexcept { return stages; }
+
+	// Applies the stages one after another on the whole input. The result is in one of the buffers of the cascade,
+	// so the returned view is valid until the next application.
+	std::string_view apply(std::string_view input)
+	{
+		std::string_view curr = input;
+		for(std::size_t i = 0; i < stages.size(); i++)
+		{
+			Word& next = buffers[i % 2];
+			next.clear();
+			timed(i, [&] { stages[i](curr, next, right_path); });
+			curr = next;
+		}
+		return curr;
+	}
+	Word operator()(std::string_view input)
+	{
+		return Word{apply(input)};
+	}
+
+	// Replaces text with the output of apply for it. Stages which are applied in place (see CompiledBimachineWithFinalOutput::InPlace)
+	// do not use a second buffer, so for such cascades the peak memory is about half of that of apply.
+	void apply_in_place(Word& text) requires std::same_as<Bimachine, CompiledBimachineWithFinalOutput>
+	{
+		for(std::size_t i = 0; i < stages.size(); i++)
+			timed(i, [&] { stages[i].apply_in_place(text, right_path); });
+	}
+
+	// Same output as apply, but the input is cut into tiles of about tile_size symbols and all stages are applied on a tile before the next one,
+	// so the intermediate results stay in the cache. Every stage emits the output for a tile up to its last right-synchronizing symbol
+	// and keeps the rest for the next tile (see BimachineStream). Stages which cannot be applied this way run over the whole input.
+	void apply_tiled(std::string_view input, OutputSink auto& sink, std::size_t tile_size = 1 << 15)
+	{
+		if constexpr(!TileableBimachine<Bimachine>)
+			sink.append(apply(input));
+		else
+		{
+			std::vector<BimachineStream> streams(stages.begin(), stages.end());
+			if(!tile_size)
+				tile_size = input.size();
+			for(std::size_t begin = 0; ; begin += tile_size)
+			{
+				bool last = input.size() - begin <= tile_size;
+				std::string_view curr = input.substr(begin, tile_size);
+				for(std::size_t i = 0; i < stages.size(); i++)
+				{
+					Word& next = buffers[i % 2];
+					next.clear();
+					timed(i, [&] { streams[i].feed(curr, last, next); });
+					curr = next;
+				}
+				sink.append(curr);
+				if(last)
+					break;
+			}
+		}
+	}
+
+	// The edit script which turns input into the output of apply (see editScript.hpp). The scripts of the stages are composed, and every stage
+	// reads its input as the pieces of input and of the replacements given by the script so far (see edited_pieces), so the intermediate results
+	// are never built. Every stage still runs its automata over its whole input and uses a right path of its length, which is reused by all stages.
+	std::vector<Edit> find_edits(std::string_view input) requires std::same_as<Bimachine, CompiledBimachineWithFinalOutput>
+	{
+		std::vector<Edit> edits, stage_edits;
+		std::vector<std::string_view> pieces{input};
+		for(std::size_t i = 0; i < stages.size(); i++)
+		{
+			timed(i, [&] { stages[i].find_edits(pieces, stage_edits, right_path); });
+			edits = i ? compose_edits(edits, stage_edits) : std::move(stage_edits);
+			if(i + 1 < stages.size())
+				edited_pieces(input, edits, pieces);
+		}
+		return edits;
+	}
+
+	// the time spent in each stage since the construction or the last call of reset_timings
+	const std::vector<Clock::duration>& timings() const noexcept { return stage_time; }
+	void reset_timings()
+	{
+		stage_time.assign(stages.size(), {});
+	}
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef BIMACHINECOMPOSITION_HPP
+#define BIMACHINECOMPOSITION_HPP
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <algorithm>
+#include "compiledBimachine.hpp"
+#include "denseDFA.hpp"
+#include "outputPool.hpp"
+#include "constants.hpp"
+
+struct CompositionLimits
+{
+	std::size_t max_states = 1 << 12; // of each of the automata of the composed bimachine, before minimization
+	std::size_t max_psi_entries = 1 << 24; // of the psi table of the composed bimachine, before minimization
+};
+
+// Builds a bimachine equivalent to applying first and then second.
+// The output of first before position i is determined by the state of the right automaton of first at i, so the left state of the composition
+// is a pair (l, phi) of a left state of first and a function phi from the right states of first to the left states of second,
+// which gives the state of the left automaton of second before the output of first for position i. Symmetrically, the right state is a pair (r, chi)
+// of a right state of first and a function chi from the left states of first to the right states of second. Only the reachable pairs are built,
+// and the resulting automata are minimized by partition refinement with respect to psi and iota.
+// A symbol is composed if second can be applied on every output of first for it: it is in the alphabet of second
+// or first always rewrites it, e.g. when first normalizes symbols which second does not know (see PorterStemmer::normalization).
+class BimachineComposer
+{
+	using Bimachine = CompiledBimachineWithFinalOutput;
+
+	const Bimachine& first;
+	const Bimachine& second;
+	CompositionLimits limits;
+	Bimachine result;
+	std::vector<std::uint32_t> first_class_of, second_class_of; // [composed class]
+	std::vector<State> pair_state; // [composed state] -> the state of first in the pair
+	std::vector<std::vector<State>> pair_function; // [composed state] -> the function in the pair
+	std::vector<State> left_table, right_table; // [composed state][composed class]
+	State left_cnt = 0, right_cnt = 0;
+	std::vector<State> right_path; // scratch space for second
+	Word scratch;
+
+	bool second_accepts(std::string_view w) const
+	{
+		return std::ranges::all_of(w, [&](Symbol b) { return second.class_of[static_cast<USymbol>(b)] != Constants::InvalidColumn; });
+	}
+	// whether second can be applied on the output of first for a in any context; a must be in the alphabet of first
+	bool composable(Symbol a) const
+	{
+		std::uint32_t first_c = first.class_of[static_cast<USymbol>(a)];
+		for(State L = 0; L < first.left.states(); L++)
+			for(State R = 0; R < first.right.states(); R++)
+				if(std::uint32_t out = first.psi[first.psi_index(L, first_c, R)]; out == OutputPool::Identity ? !second_accepts({&a, 1}) : !second_accepts(first.outputs[out]))
+					return false;
+		return true;
+	}
+	// the state of the left automaton of second after the output of first for the symbols of class c in the context (L, R) of first
+	State run_second_left(State st, std::uint32_t c, State L, State R) const
+	{
+		std::uint32_t out = first.psi[first.psi_index(L, first_class_of[c], R)];
+		if(out == OutputPool::Identity)
+			return second.left.next(st, second_class_of[c]);
+		for(Symbol b : first.outputs[out])
+			st = second.left.successor(st, b);
+		return st;
+	}
+	// the state of the right automaton of second after the reversed output of first for the symbols of class c in the context (L, R) of first
+	State run_second_right(State st, std::uint32_t c, State L, State R) const
+	{
+		std::uint32_t out = first.psi[first.psi_index(L, first_class_of[c], R)];
+		if(out == OutputPool::Identity)
+			return second.right.next(st, second_class_of[c]);
+		for(Symbol b : first.outputs[out] | std::views::reverse)
+			st = second.right.successor(st, b);
+		return st;
+	}
+
+	// Builds the reachable pairs from initial; successor(state, function, c) returns the pair after the symbols of class c.
+	// Returns false if there are more than limits.max_states pairs.
+	template<class Successor>
+	bool explore(std::pair<State, std::vector<State>> initial, Successor successor, std::vector<State>& states, std::vector<std::vector<State>>& functions, std::vector<State>& table)
+	{
+		std::map<std::pair<State, std::vector<State>>, State> index_of;
+		index_of.emplace(initial, 0);
+		states.push_back(initial.first);
+		functions.push_back(std::move(initial.second));
+		for(State i = 0; i < states.size(); i++)
+			for(std::uint32_t c = 0; c < result.classes_cnt; c++)
+			{
+				auto next = successor(states[i], functions[i], c);
+				auto [it, inserted] = index_of.try_emplace(next, states.size());
+				if(inserted)
+				{
+					if(states.size() == limits.max_states)
+						return false;
+					states.push_back(next.first);
+					functions.push_back(std::move(next.second));
+				}
+				table.push_back(it->second);
+			}
+		return true;
+	}
+
+	// the automaton whose states are the colors, with the state of color[initial] as initial state
+	DenseDFA quotient(const std::vector<State>& color, State colors_cnt, const std::vector<State>& table, State initial) const
+	{
+		std::vector<State> quotient_table(static_cast<std::size_t>(colors_cnt) * result.classes_cnt);
+		for(State st = 0; st < color.size(); st++)
+			for(std::uint32_t c = 0; c < result.classes_cnt; c++)
+				quotient_table[color[st] * result.classes_cnt + c] = color[table[st * result.classes_cnt + c]];
+		return DenseDFA(result.class_of, result.classes_cnt, colors_cnt, color[initial], std::move(quotient_table));
+	}
+
+	BimachineComposer(const Bimachine& first, const Bimachine& second, const CompositionLimits& limits): first(first), second(second), limits(limits) {}
+
+	std::optional<Bimachine> compose()
+	{
+		// a composed class is a pair of a class of first and a class of second
+		std::map<std::pair<std::uint32_t, std::uint32_t>, std::uint32_t> classes;
+		result.class_of.fill(Constants::InvalidColumn);
+		for(std::size_t a = 0; a < result.class_of.size(); a++)
+			if(first.class_of[a] != Constants::InvalidColumn && composable(static_cast<Symbol>(a)))
+			{
+				auto [it, inserted] = classes.try_emplace({first.class_of[a], second.class_of[a]}, classes.size());
+				if(inserted)
+				{
+					first_class_of.push_back(first.class_of[a]);
+					second_class_of.push_back(second.class_of[a]);
+				}
+				result.class_of[a] = it->second;
+			}
+		result.classes_cnt = classes.size();
+
+		std::vector<State> left_states, right_states;
+		std::vector<std::vector<State>> phi, chi;
+		bool within_limits = explore({first.left.initial(), std::vector<State>(first.right.states(), second.left.initial())},
+			[&](State L, const std::vector<State>& phi, std::uint32_t c) {
+				std::pair<State, std::vector<State>> next{first.left.next(L, first_class_of[c]), std::vector<State>(phi.size())};
+				for(State R = 0; R < phi.size(); R++)
+					next.second[R] = run_second_left(phi[first.right.next(R, first_class_of[c])], c, L, R);
+				return next;
+			}, left_states, phi, left_table);
+		if(!within_limits)
+			return std::nullopt;
+
+		std::vector<State> chi_initial;
+		for(State L = 0; L < first.left.states(); L++)
+		{
+			if(!second_accepts(first.outputs[first.iota[L]]))
+				return std::nullopt;
+			State st = second.right.initial();
+			for(Symbol b : first.outputs[first.iota[L]] | std::views::reverse)
+				st = second.right.successor(st, b);
+			chi_initial.push_back(st);
+		}
+		within_limits = explore({first.right.initial(), std::move(chi_initial)},
+			[&](State R, const std::vector<State>& chi, std::uint32_t c) {
+				std::pair<State, std::vector<State>> next{first.right.next(R, first_class_of[c]), std::vector<State>(chi.size())};
+				for(State L = 0; L < chi.size(); L++)
+					next.second[L] = run_second_right(chi[first.left.next(L, first_class_of[c])], c, L, R);
+				return next;
+			}, right_states, chi, right_table);
+		if(!within_limits || static_cast<std::size_t>(left_states.size()) * result.classes_cnt * right_states.size() > limits.max_psi_entries)
+			return std::nullopt;
+
+		// the output for a class c between the composed states (L, phi) and (R, chi) is the output of second between phi(R') and chi(L')
+		// on the output of first between L and R, where L' and R' are the states of first after c
+		std::map<std::tuple<std::uint32_t, State, State>, std::uint32_t> memo; // (output id in first, left state of second, right state of second) -> output id
+		const std::size_t L_cnt = left_states.size(), R_cnt = right_states.size();
+		std::vector<std::uint32_t> psi(L_cnt * result.classes_cnt * R_cnt);
+		for(State Li = 0; Li < L_cnt; Li++)
+			for(std::uint32_t c = 0; c < result.classes_cnt; c++)
+				for(State Ri = 0; Ri < R_cnt; Ri++)
+				{
+					State L = left_states[Li], R = right_states[Ri];
+					State second_L = phi[Li][first.right.next(R, first_class_of[c])], second_R = chi[Ri][first.left.next(L, first_class_of[c])];
+					std::uint32_t out = first.psi[first.psi_index(L, first_class_of[c], R)], composed;
+					if(out == OutputPool::Identity)
+					{
+						std::uint32_t second_out = second.psi[second.psi_index(second_L, second_class_of[c], second_R)];
+						composed = second_out == OutputPool::Identity ? OutputPool::Identity : result.outputs.intern(second.outputs[second_out]);
+					}
+					else if(auto [it, inserted] = memo.try_emplace({out, second_L, second_R}); !inserted)
+						composed = it->second;
+					else
+					{
+						scratch.clear();
+						second.apply_between(first.outputs[out], second_L, second_R, scratch, right_path);
+						composed = it->second = result.outputs.intern(scratch);
+					}
+					psi[(Li * result.classes_cnt + c) * R_cnt + Ri] = composed;
+				}
+		std::vector<std::uint32_t> iota;
+		for(State Li = 0; Li < L_cnt; Li++)
+		{
+			scratch.clear();
+			State second_L = second.apply_between(first.outputs[first.iota[left_states[Li]]], phi[Li][first.right.initial()], second.right.initial(), scratch, right_path);
+			second.final_output(second_L, scratch);
+			iota.push_back(result.outputs.intern(scratch));
+		}
+
+		// the right states are merged first, using the columns of psi; then the left states, using the rows of psi on the merged right states and iota
+		std::vector<State> right_color;
+		{
+			std::map<std::vector<std::uint32_t>, State> index_of;
+			for(State Ri = 0; Ri < R_cnt; Ri++)
+			{
+				std::vector<std::uint32_t> column;
+				for(std::size_t row = 0; row < L_cnt * result.classes_cnt; row++)
+					column.push_back(psi[row * R_cnt + Ri]);
+				right_color.push_back(index_of.try_emplace(std::move(column), index_of.size()).first->second);
+			}
+		}
+		State right_colors_cnt = DenseDFA::refine(right_color, right_table, result.classes_cnt);
+		std::vector<State> right_representative(right_colors_cnt);
+		for(State Ri = R_cnt; Ri-- > 0;)
+			right_representative[right_color[Ri]] = Ri;
+
+		std::vector<State> left_color;
+		{
+			std::map<std::vector<std::uint32_t>, State> index_of;
+			for(State Li = 0; Li < L_cnt; Li++)
+			{
+				std::vector<std::uint32_t> row{iota[Li]};
+				for(std::uint32_t c = 0; c < result.classes_cnt; c++)
+					for(State Ri : right_representative)
+						row.push_back(psi[(Li * result.classes_cnt + c) * R_cnt + Ri]);
+				left_color.push_back(index_of.try_emplace(std::move(row), index_of.size()).first->second);
+			}
+		}
+		State left_colors_cnt = DenseDFA::refine(left_color, left_table, result.classes_cnt);
+		std::vector<State> left_representative(left_colors_cnt);
+		for(State Li = L_cnt; Li-- > 0;)
+			left_representative[left_color[Li]] = Li;
+
+		result.left = quotient(left_color, left_colors_cnt, left_table, 0);
+		result.right = quotient(right_color, right_colors_cnt, right_table, 0);
+		result.psi.resize(static_cast<std::size_t>(left_colors_cnt) * result.classes_cnt * right_colors_cnt);
+		for(State L = 0; L < left_colors_cnt; L++)
+			for(std::uint32_t c = 0; c < result.classes_cnt; c++)
+				for(State R = 0; R < right_colors_cnt; R++)
+					result.psi[result.psi_index(L, c, R)] = psi[(left_representative[L] * result.classes_cnt + c) * R_cnt + right_representative[R]];
+		for(State Li : left_representative)
+			result.iota.push_back(iota[Li]);
+		result.find_always_identity();
+		result.in_place = result.output_never_ahead();
+		return std::move(result);
+	}
+
+	friend std::optional<Bimachine> compose(const Bimachine& first, const Bimachine& second, const CompositionLimits& limits);
+};
+
+// a bimachine equivalent to applying first and then second, or std::nullopt if it would exceed limits
+inline std::optional<CompiledBimachineWithFinalOutput> compose(const CompiledBimachineWithFinalOutput& first, const CompiledBimachineWithFinalOutput& second, const CompositionLimits& limits = {})
+{
+	return BimachineComposer(first, second, limits).compose();
+}
+
+// Composes consecutive stages of the cascade as long as the result stays within limits; the result is equivalent to the cascade.
+inline std::vector<CompiledBimachineWithFinalOutput> compose_cascade(const std::vector<CompiledBimachineWithFinalOutput>& stages, const CompositionLimits& limits = {})
+{
+	std::vector<CompiledBimachineWithFinalOutput> composed;
+	for(const auto& stage : stages)
+		if(composed.empty())
+			composed.push_back(stage);
+		else if(auto both = compose(composed.back(), stage, limits))
+			composed.back() = std::move(*both);
+		else
+			composed.push_back(stage);
+	return composed;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef BIMACHINESTREAM_HPP
+#define BIMACHINESTREAM_HPP
+
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include "compiledBimachine.hpp"
+#include "outputSink.hpp"
+#include "constants.hpp"
+
+// Application of a CompiledBimachineWithFinalOutput on an input which arrives in pieces. The output for the symbols before
+// the last right-synchronizing symbol seen so far does not depend on the rest of the input, so it is emitted as soon as the symbol arrives;
+// the symbols after it are kept together with the state of the left automaton. Without right-synchronizing symbols everything is kept until the end.
+class BimachineStream
+{
+	const CompiledBimachineWithFinalOutput* bm;
+	Word carry;
+	State curr_left_st;
+	std::vector<State> right_path;
+public:
+	explicit BimachineStream(const CompiledBimachineWithFinalOutput& bm): bm(&bm), curr_left_st(bm.left_initial()) {}
+
+	// appends to sink the output determined by the input given so far; last means that piece ends the input, which flushes everything
+	template<OutputSink Sink>
+	void feed(std::string_view piece, bool last, Sink& sink)
+	{
+		std::size_t scanned = carry.size();
+		carry += piece;
+		if(last)
+		{
+			curr_left_st = bm->apply_between(carry, curr_left_st, bm->right_initial(), sink, right_path);
+			bm->final_output(curr_left_st, sink);
+			reset();
+			return;
+		}
+		State curr_right_st = Constants::InvalidState;
+		std::size_t sync = carry.size();
+		while(sync > scanned && (curr_right_st = bm->right_synchronized_state(carry[sync - 1])) == Constants::InvalidState)
+			sync--;
+		if(sync-- == scanned)
+			return;
+		curr_left_st = bm->apply_between(std::string_view{carry}.substr(0, sync), curr_left_st, curr_right_st, sink, right_path);
+		carry.erase(0, sync);
+	}
+	// forgets the input given so far
+	void reset()
+	{
+		carry.clear();
+		curr_left_st = bm->left_initial();
+	}
+	// the number of symbols whose output is not emitted yet
+	std::size_t pending() const noexcept { return carry.size(); }
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef BOUNDEDDELAYSTREAM_HPP
+#define BOUNDEDDELAYSTREAM_HPP
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <stdexcept>
+#include "compiledBimachine.hpp"
+#include "outputSink.hpp"
+#include "constants.hpp"
+
+// Single left-to-right pass of a CompiledBimachineWithFinalOutput with bounded lookahead k (see CompiledBimachineWithFinalOutput::lookahead).
+// The output for a symbol is emitted as soon as the k symbols after it have arrived: the right state is found by running the right automaton
+// over these k symbols only (or up to the first right-synchronizing symbol among them), which gives a state with the same outputs as the actual one.
+// Only the last k + 1 symbols are kept.
+class BoundedDelayStream
+{
+	const CompiledBimachineWithFinalOutput* bm;
+	std::size_t k;
+	Word window; // the symbols whose output is not emitted yet; at most k after each call of feed
+	std::size_t first = 0; // window[0, first) is already processed and is erased when it grows large
+	State curr_left_st;
+
+	// the output for window[first], which is followed by the rest of the window
+	template<OutputSink Sink>
+	void emit(Sink& sink)
+	{
+		// reading starts at the first right-synchronizing symbol after window[first], since what follows it does not matter
+		std::size_t sync = first + 1;
+		State curr_right_st = Constants::InvalidState;
+		while(sync < window.size() && (curr_right_st = bm->right_synchronized_state(window[sync])) == Constants::InvalidState)
+			sync++;
+		if(sync == window.size())
+			curr_right_st = bm->right_initial();
+		while(sync-- > first + 1)
+			curr_right_st = bm->right_successor(curr_right_st, window[sync]);
+		curr_left_st = bm->apply_symbol(window[first++], curr_left_st, curr_right_st, sink);
+	}
+public:
+	// throws std::invalid_argument if the lookahead of bm is unbounded
+	explicit BoundedDelayStream(const CompiledBimachineWithFinalOutput& bm): bm(&bm), curr_left_st(bm.left_initial())
+	{
+		auto lookahead = bm.lookahead();
+		if(!lookahead)
+			throw std::invalid_argument("the lookahead of the bimachine is unbounded");
+		k = *lookahead;
+	}
+	// k must be at least the lookahead of bm
+	BoundedDelayStream(const CompiledBimachineWithFinalOutput& bm, std::size_t k): bm(&bm), k(k), curr_left_st(bm.left_initial()) {}
+
+	// appends to sink the output for the symbols followed by at least k symbols
+	template<OutputSink Sink>
+	void feed(std::string_view piece, Sink& sink)
+	{
+		for(Symbol s : piece)
+		{
+			window.push_back(s);
+			if(window.size() - first > k)
+				emit(sink);
+			if(first > k + 64)
+			{
+				window.erase(0, first);
+				first = 0;
+			}
+		}
+	}
+	// appends to sink the output for the remaining symbols and the final output; the stream can then be reused for a new input
+	template<OutputSink Sink>
+	void finish(Sink& sink)
+	{
+		while(first < window.size())
+			emit(sink);
+		bm->final_output(curr_left_st, sink);
+		window.clear();
+		first = 0;
+		curr_left_st = bm->left_initial();
+	}
+	std::size_t Lookahead() const noexcept { return k; }
+};
+
+#endif
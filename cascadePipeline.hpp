@@ -0,0 +1,303 @@
+#ifndef CASCADEPIPELINE_HPP
+#define CASCADEPIPELINE_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include "compiledBimachine.hpp"
+#include "bimachineStream.hpp"
+#include "spscQueue.hpp"
+#include "constants.hpp"
+
+// Pipelined application of a cascade of bimachines on a stream. Every stage runs on its own thread(s) and the stages are connected by bounded SpscQueues
+// of chunks, so reading, all steps and writing overlap. A stage is applied as a BimachineStream on the chunks it receives.
+// A replicated stage is additionally cut before right-synchronizing symbols by a dispatcher, which runs the left automaton over the symbols it hands out,
+// so every piece is sent with the states of both automata at its ends. The pieces are handed to the replicas in turn and their outputs
+// are collected in the same order, so the output is the same as the sequential one.
+
+struct PipelineOptions
+{
+	std::size_t chunk_size = 1 << 16; // of the chunks read from the input
+	std::size_t queue_capacity = 8; // chunks between two threads
+	std::vector<std::size_t> replicas{}; // the number of threads applying each stage; 1 for missing entries and for stages without right-synchronizing symbols
+	std::size_t threads_cnt = 0; // if replicas is empty and this is not 0, replicas is chosen by calibrate_replicas on the first chunk
+};
+
+struct PipelineChunk
+{
+	Word text;
+	bool last = false;
+};
+
+namespace PipelineInternal
+{
+	using Queue = SpscQueue<PipelineChunk>;
+
+	struct Segment
+	{
+		Word text{};
+		State left_st = Constants::InvalidState, right_st = Constants::InvalidState; // before text and after what follows text reversed
+		bool last = false; // the final output is appended after text
+		bool stop = false; // no more segments for this replica
+	};
+
+	// the first exception thrown by any thread of the pipeline
+	class Errors
+	{
+		std::mutex mutex;
+		std::exception_ptr first;
+	public:
+		void record(std::exception_ptr e)
+		{
+			std::lock_guard lock(mutex);
+			if(!first)
+				first = e;
+		}
+		void rethrow()
+		{
+			if(first)
+				std::rethrow_exception(first);
+		}
+	};
+
+	// takes chunks from in until the last one; a stage which failed still has to do this, so that the threads before it are not blocked
+	inline void drain(Queue& in, bool last_seen)
+	{
+		while(!last_seen)
+			last_seen = in.pop().last;
+	}
+
+	// whether pieces of the input of bm can be applied independently, given the left state before them
+	inline bool replicable(const CompiledBimachineWithFinalOutput& bm)
+	{
+		return !bm.right_synchronizing_symbols().empty();
+	}
+
+	inline void sequential_stage(const CompiledBimachineWithFinalOutput& bm, Queue& in, Queue& out, Errors& errors)
+	{
+		BimachineStream stream(bm);
+		bool last = false;
+		try
+		{
+			while(!last)
+			{
+				PipelineChunk chunk = in.pop();
+				last = chunk.last;
+				PipelineChunk result{{}, last};
+				stream.feed(chunk.text, last, result.text);
+				if(!result.text.empty() || last)
+					out.push(std::move(result));
+			}
+		}
+		catch(...)
+		{
+			errors.record(std::current_exception());
+			drain(in, last);
+			out.push({{}, true});
+		}
+	}
+
+	inline void dispatch(const CompiledBimachineWithFinalOutput& bm, Queue& in, std::vector<std::unique_ptr<SpscQueue<Segment>>>& replicas, Errors& errors)
+	{
+		Word carry;
+		State curr_left_st = bm.left_initial();
+		std::size_t next_replica = 0;
+		bool last = false;
+		auto send = [&](Segment segment) {
+			replicas[next_replica]->push(std::move(segment));
+			next_replica = (next_replica + 1) % replicas.size();
+		};
+		try
+		{
+			while(!last)
+			{
+				PipelineChunk chunk = in.pop();
+				last = chunk.last;
+				std::size_t scanned = carry.size();
+				carry += chunk.text;
+				if(last)
+					break;
+				// the piece ends before the last right-synchronizing symbol; the left automaton reads every symbol once, when its piece is sent
+				State curr_right_st = Constants::InvalidState;
+				std::size_t sync = carry.size();
+				while(sync > scanned && (curr_right_st = bm.right_synchronized_state(carry[sync - 1])) == Constants::InvalidState)
+					sync--;
+				if(sync-- == scanned || !sync)
+					continue;
+				std::string_view piece = std::string_view{carry}.substr(0, sync);
+				State next_left_st = bm.left_successor(curr_left_st, piece);
+				send({Word{piece}, curr_left_st, curr_right_st});
+				carry.erase(0, sync);
+				curr_left_st = next_left_st;
+			}
+		}
+		catch(...)
+		{
+			errors.record(std::current_exception());
+			drain(in, last);
+			carry.clear();
+		}
+		send({std::move(carry), curr_left_st, bm.right_initial(), true});
+		for(std::size_t i = 1; i < replicas.size(); i++)
+			send({.stop = true});
+	}
+
+	inline void replica(const CompiledBimachineWithFinalOutput& bm, SpscQueue<Segment>& in, Queue& out, Errors& errors)
+	{
+		std::vector<State> right_path;
+		for(;;)
+		{
+			Segment segment = in.pop();
+			if(segment.stop)
+				return;
+			PipelineChunk result{{}, segment.last};
+			try
+			{
+				result.text.reserve(segment.text.size());
+				State curr_left_st = bm.apply_between(segment.text, segment.left_st, segment.right_st, result.text, right_path);
+				if(segment.last)
+					bm.final_output(curr_left_st, result.text);
+			}
+			catch(...)
+			{
+				errors.record(std::current_exception());
+				result.text.clear();
+			}
+			out.push(std::move(result));
+			if(segment.last)
+				return;
+		}
+	}
+
+	// the outputs of the replicas are taken in the order in which the dispatcher handed out the segments
+	inline void collect(std::vector<std::unique_ptr<Queue>>& replicas, Queue& out)
+	{
+		for(std::size_t i = 0; ; i = (i + 1) % replicas.size())
+		{
+			PipelineChunk chunk = replicas[i]->pop();
+			bool last = chunk.last;
+			out.push(std::move(chunk));
+			if(last)
+				return;
+		}
+	}
+}
+
+// Chooses the number of threads of every stage in proportion to the time the stage takes on sample, using about threads_cnt threads in total.
+inline std::vector<std::size_t> calibrate_replicas(const std::vector<CompiledBimachineWithFinalOutput>& cascade, std::string_view sample, std::size_t threads_cnt = std::thread::hardware_concurrency())
+{
+	std::vector<double> cost;
+	Word curr{sample}, next;
+	std::vector<State> right_path;
+	for(const auto& bm : cascade)
+	{
+		auto start = std::chrono::steady_clock::now();
+		next.clear();
+		bm(curr, next, right_path);
+		cost.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		std::swap(curr, next);
+	}
+	double total = 0;
+	for(double c : cost)
+		total += c;
+	std::vector<std::size_t> replicas;
+	for(std::size_t i = 0; i < cascade.size(); i++)
+		replicas.push_back(PipelineInternal::replicable(cascade[i]) && total > 0 ? std::max<std::size_t>(1, std::lround(threads_cnt * cost[i] / total)) : 1);
+	return replicas;
+}
+
+// Applies the cascade on everything read from is and writes the result to os; the output is the same as applying the steps one after another.
+// An exception thrown by any stage is rethrown after all threads have stopped.
+inline void run_pipeline(const std::vector<CompiledBimachineWithFinalOutput>& cascade, std::istream& is, std::ostream& os, const PipelineOptions& options = {})
+{
+	using namespace PipelineInternal;
+	struct Replicated
+	{
+		std::vector<std::unique_ptr<SpscQueue<Segment>>> segments;
+		std::vector<std::unique_ptr<Queue>> results;
+	};
+	// all queues are created before any thread starts
+	std::deque<Queue> links; // links[i] is the input of stage i and links.back() is the output
+	for(std::size_t i = 0; i <= cascade.size(); i++)
+		links.emplace_back(options.queue_capacity);
+	// the first chunk is read before the threads start, so that the replicas can be calibrated on it
+	PipelineChunk first{Word(options.chunk_size, '\0'), false};
+	is.read(first.text.data(), first.text.size());
+	first.text.resize(is.gcount());
+	first.last = !is;
+	std::vector<std::size_t> replicas = options.replicas;
+	if(replicas.empty() && options.threads_cnt)
+		replicas = calibrate_replicas(cascade, first.text, options.threads_cnt);
+	std::vector<Replicated> replicated(cascade.size()); // empty for the stages with one thread
+	for(std::size_t i = 0; i < cascade.size(); i++)
+		if(std::size_t replicas_cnt = i < replicas.size() ? replicas[i] : 1; replicas_cnt > 1 && replicable(cascade[i]))
+			for(std::size_t r = 0; r < replicas_cnt; r++)
+			{
+				replicated[i].segments.push_back(std::make_unique<SpscQueue<Segment>>(options.queue_capacity));
+				replicated[i].results.push_back(std::make_unique<Queue>(options.queue_capacity));
+			}
+
+	Errors errors;
+	{
+		std::vector<std::jthread> threads;
+		threads.emplace_back([&] {
+			bool last = first.last;
+			try
+			{
+				links[0].push(std::move(first));
+				while(!last)
+				{
+					PipelineChunk chunk{Word(options.chunk_size, '\0'), false};
+					is.read(chunk.text.data(), chunk.text.size());
+					chunk.text.resize(is.gcount());
+					last = chunk.last = !is;
+					links[0].push(std::move(chunk));
+				}
+			}
+			catch(...)
+			{
+				errors.record(std::current_exception());
+				if(!last)
+					links[0].push({{}, true});
+			}
+		});
+		for(std::size_t i = 0; i < cascade.size(); i++)
+		{
+			const auto& bm = cascade[i];
+			auto& [segments, results] = replicated[i];
+			if(segments.empty())
+			{
+				threads.emplace_back([&, i] { sequential_stage(bm, links[i], links[i + 1], errors); });
+				continue;
+			}
+			threads.emplace_back([&, i] { dispatch(bm, links[i], segments, errors); });
+			for(std::size_t r = 0; r < segments.size(); r++)
+				threads.emplace_back([&, r] { replica(bm, *segments[r], *results[r], errors); });
+			threads.emplace_back([&, i] { collect(results, links[i + 1]); });
+		}
+
+		for(bool last = false; !last;)
+		{
+			PipelineChunk chunk = links.back().pop();
+			last = chunk.last;
+			os.write(chunk.text.data(), chunk.text.size());
+		}
+	}
+	errors.rethrow();
+	if(!os)
+		throw std::runtime_error("could not write the output");
+}
+
+#endif
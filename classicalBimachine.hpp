@@ -6,10 +6,14 @@
 #include <utility>
 #include <map>
 #include <unordered_map>
+#include <string_view>
+#include <ranges>
 #include "twostepBimachine.hpp"
 #include "classicalFSA.hpp"
+#include "denseDFA.hpp"
 #include "monoidalFSA.hpp"
 #include "utilities.hpp"
+#include "outputSink.hpp"
 
 #if __has_include(<boost/unordered/unordered_flat_map.hpp>)
 #	include <boost/unordered/unordered_flat_map.hpp>
@@ -21,7 +25,10 @@
 
 class BimachineWithFinalOutput
 {
+	friend class CompiledBimachineWithFinalOutput;
+
 	ClassicalFSA left, right;
+	DenseDFA dense_left, dense_right; // run-optimized views of left and right
 #ifdef LIBBOOST_UNORDERED_FLAT_MAP_AVAILABLE
 	boost::unordered_flat_map<std::tuple<State, Symbol, State>, Word> psi;
 #else
@@ -220,6 +227,8 @@ public:
 		this->right = std::move(right.A_R).getMFSA();
 
 		pseudo_minimize(left_states_of_index, right_states_of_index, index_of_left_state, index_of_right_state);
+		dense_left = DenseDFA{this->left};
+		dense_right = DenseDFA{this->right};
 
 		//debug
 		//std::cerr << "\t\tleft states: " << this->left.statesCnt << '\n';
@@ -231,19 +240,33 @@ public:
 		/*this->left.print(std::cerr << "left:\n") << '\n';
 		this->right.print(std::cerr << "right:\n") << '\n';*/
 	}
-	Word operator()(const Word& input) const
+	// right_path is scratch space; passing the same vector to successive calls avoids reallocating it
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink, std::vector<State>& right_path) const
 	{
-		std::vector<State> right_path = right.findPath(std::ranges::reverse_view(input));
-
-		Word output;
-		State curr_left_st = *left.initial.begin();
+		dense_right.findPath(std::ranges::reverse_view(input), right_path);
+		State curr_left_st = dense_left.initial();
 		for(auto right_path_rev_it = right_path.rbegin(); Symbol s : input)
 		{
-			output += value_or(psi, {curr_left_st, s, *++right_path_rev_it}, {s});
-			curr_left_st = left.successor(curr_left_st, s);
+			if(auto it = psi.find({curr_left_st, s, *++right_path_rev_it}); it != psi.end())
+				sink.append(it->second);
+			else
+				sink.push_back(s);
+			curr_left_st = dense_left.successor(curr_left_st, s);
 		}
 		if(auto it = iota.find(curr_left_st); it != iota.end())
-			output += it->second;
+			sink.append(it->second);
+	}
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink) const
+	{
+		std::vector<State> right_path;
+		(*this)(input, sink, right_path);
+	}
+	Word operator()(const Word& input) const
+	{
+		Word output;
+		(*this)(std::string_view{input}, output);
 		return output;
 	}
 };
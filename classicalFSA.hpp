@@ -23,6 +23,9 @@ class ClassicalFSA: public MonoidalFSA<SymbolOrEpsilon>
 	friend class TSBM_RightAutomaton;
 	friend class TwostepBimachine;
 	friend class BimachineWithFinalOutput;
+	friend class CompiledBimachineWithFinalOutput;
+	friend class CompiledTwostepBimachine;
+	friend class DenseDFA;
 
 	virtual std::vector<SymbolOrEpsilon> findPseudoAlphabet() const override
 	{
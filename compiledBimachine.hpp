@@ -0,0 +1,658 @@
+#ifndef COMPILED_BIMACHINE_HPP
+#define COMPILED_BIMACHINE_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <ranges>
+#include <span>
+#include <optional>
+#include <future>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include "classicalBimachine.hpp"
+#include "denseDFA.hpp"
+#include "outputPool.hpp"
+#include "outputSink.hpp"
+#include "editScript.hpp"
+#include "threadPool.hpp"
+#include "parallelRun.hpp"
+#include "constants.hpp"
+
+// Frozen form of BimachineWithFinalOutput. Symbols on which the left automaton, the right automaton and psi behave identically
+// are merged into one symbol class and all functions are stored in dense tables, so applying it needs only array indexing.
+class CompiledBimachineWithFinalOutput
+{
+	friend class BimachineComposer;
+	friend class SequentialTransducer;
+
+	DenseDFA::ColumnMap class_of; // class_of[c] == Constants::InvalidColumn <=> c is not in the alphabet
+	std::uint32_t classes_cnt = 0;
+	DenseDFA left, right; // both use the symbol classes as columns
+	std::vector<std::uint32_t> psi; // [left][class][right] -> output id or OutputPool::Identity
+	std::vector<std::uint32_t> iota; // [left] -> output id
+	OutputPool outputs;
+	std::vector<std::uint8_t> always_identity; // [left][class] -> whether psi is OutputPool::Identity for every right state
+	bool in_place = false; // whether the output is never ahead of the input, see output_never_ahead
+
+	CompiledBimachineWithFinalOutput() = default; // for BimachineComposer
+
+	std::size_t psi_index(State L, std::uint32_t c, State R) const noexcept
+	{
+		return (static_cast<std::size_t>(L) * classes_cnt + c) * right.states() + R;
+	}
+	// must be called whenever psi changes
+	void find_always_identity()
+	{
+		always_identity.assign(static_cast<std::size_t>(left.states()) * classes_cnt, 0);
+		for(State L = 0; L < left.states(); L++)
+			for(std::uint32_t c = 0; c < classes_cnt; c++)
+				always_identity[L * classes_cnt + c] = std::ranges::all_of(std::views::iota(State{0}, right.states()),
+					[&](State R) { return psi[psi_index(L, c, R)] == OutputPool::Identity; });
+	}
+	// Whether for every input the output for the first j symbols is at most j symbols long for every j, including the final output at the end,
+	// so the output can be written over the input while reading it. The graph has a node (L, R) for the left state before a position
+	// and the right state used at the previous one; reading a symbol with the right state R' used at its position goes to (L', R') and gains
+	// 1 - |psi| symbols of slack. The least slack of every node over all paths from (initial, any R) is found by relaxing the edges until nothing changes;
+	// it is capped at the largest possible loss on a path without cycles, so a cycle which loses slack drives it below 0 instead of running forever.
+	bool output_never_ahead() const
+	{
+		const State L_cnt = left.states(), R_cnt = right.states();
+		std::vector<std::size_t> pred_begin(static_cast<std::size_t>(classes_cnt) * R_cnt + 1); // the R with right.next(R, c) == R' are preds[pred_begin[c * R_cnt + R'], pred_begin[c * R_cnt + R' + 1])
+		std::vector<State> preds(static_cast<std::size_t>(classes_cnt) * R_cnt);
+		for(std::uint32_t c = 0; c < classes_cnt; c++)
+			for(State R = 0; R < R_cnt; R++)
+				pred_begin[c * R_cnt + right.next(R, c) + 1]++;
+		for(std::size_t i = 1; i < pred_begin.size(); i++)
+			pred_begin[i] += pred_begin[i - 1];
+		{
+			std::vector<std::size_t> filled(pred_begin.begin(), pred_begin.end() - 1);
+			for(std::uint32_t c = 0; c < classes_cnt; c++)
+				for(State R = 0; R < R_cnt; R++)
+					preds[filled[c * R_cnt + right.next(R, c)]++] = R;
+		}
+		std::size_t max_output = 0;
+		for(std::uint32_t id = 0; id < outputs.size(); id++)
+			max_output = std::max(max_output, outputs[id].size());
+		const long long cap = static_cast<long long>(L_cnt) * R_cnt * max_output;
+
+		constexpr long long Unreached = std::numeric_limits<long long>::max();
+		std::vector<long long> slack(static_cast<std::size_t>(L_cnt) * R_cnt, Unreached);
+		std::vector<std::uint8_t> queued(slack.size(), 0);
+		std::deque<std::size_t> queue;
+		for(State R = 0; R < R_cnt; R++)
+		{
+			slack[left.initial() * R_cnt + R] = 0;
+			queued[left.initial() * R_cnt + R] = 1;
+			queue.push_back(left.initial() * R_cnt + R);
+		}
+		while(!queue.empty())
+		{
+			std::size_t node = queue.front();
+			queue.pop_front();
+			queued[node] = 0;
+			State L = node / R_cnt, prev_R = node % R_cnt;
+			for(std::uint32_t c = 0; c < classes_cnt; c++)
+				for(std::size_t i = pred_begin[c * R_cnt + prev_R]; i < pred_begin[c * R_cnt + prev_R + 1]; i++)
+				{
+					State R = preds[i];
+					std::uint32_t out = psi[psi_index(L, c, R)];
+					long long next_slack = std::min(cap, slack[node] + 1 - static_cast<long long>(out == OutputPool::Identity ? 1 : outputs[out].size()));
+					if(next_slack < 0)
+						return false;
+					std::size_t next = left.next(L, c) * R_cnt + R;
+					if(next_slack < slack[next])
+					{
+						slack[next] = next_slack;
+						if(!queued[next])
+						{
+							queued[next] = 1;
+							queue.push_back(next);
+						}
+					}
+				}
+		}
+		// the right state used at the last position is the initial one
+		for(State L = 0; L < L_cnt; L++)
+			if(slack[L * R_cnt + right.initial()] != Unreached && slack[L * R_cnt + right.initial()] < static_cast<long long>(outputs[iota[L]].size()))
+				return false;
+		return true;
+	}
+	// Appends to sink the output for input when the left automaton starts in curr_left_st and right_at(j) is the right state used at position j.
+	// Symbols whose output is the identity are not appended one by one; every run of them is appended at once.
+	// psi is not read at all where the output is the identity for every right state. Returns the state of the left automaton after input.
+	template<OutputSink Sink, class RightAt>
+	State apply_left_pass(std::string_view input, State curr_left_st, RightAt right_at, Sink& sink) const
+	{
+		return left.withNext([&](auto next_left) {
+			std::size_t unchanged_begin = 0; // input[unchanged_begin, j) is output unchanged, but not appended yet
+			for(std::size_t j = 0; j < input.size(); j++)
+			{
+				std::uint32_t c = class_of[static_cast<USymbol>(input[j])]; // already validated by the right pass
+				if(!always_identity[curr_left_st * classes_cnt + c])
+					if(std::uint32_t out = psi[psi_index(curr_left_st, c, right_at(j))]; out != OutputPool::Identity)
+					{
+						sink.append(input.substr(unchanged_begin, j - unchanged_begin));
+						sink.append(outputs[out]);
+						unchanged_begin = j + 1;
+					}
+				curr_left_st = next_left(curr_left_st, c);
+			}
+			sink.append(input.substr(unchanged_begin));
+			return curr_left_st;
+		});
+	}
+	// the state of the left automaton before reading input[pos]; only the symbols after the last left-synchronizing symbol before pos are read
+	State left_state_at(std::string_view input, std::size_t pos) const
+	{
+		std::size_t from = pos;
+		while(from > 0 && left.synchronizedState(left.column(input[from - 1])) == Constants::InvalidState)
+			from--;
+		State curr_left_st = from > 0 ? left.synchronizedState(left.column(input[from - 1])) : left.initial();
+		for(; from < pos; from++)
+			curr_left_st = left.successor(curr_left_st, input[from]);
+		return curr_left_st;
+	}
+	// the state of the right automaton after reading input[pos, input.size()) reversed, i.e. the state used at position pos - 1;
+	// only the symbols before the first right-synchronizing symbol at or after pos are read
+	State right_state_at(std::string_view input, std::size_t pos) const
+	{
+		std::size_t to = pos;
+		while(to < input.size() && right.synchronizedState(right.column(input[to])) == Constants::InvalidState)
+			to++;
+		State curr_right_st = to < input.size() ? right.synchronizedState(right.column(input[to])) : right.initial();
+		for(; to > pos; to--)
+			curr_right_st = right.successor(curr_right_st, input[to - 1]);
+		return curr_right_st;
+	}
+	static Word symbols_of(const DenseDFA::ColumnMap& class_of, const DenseDFA& dfa)
+	{
+		Word symbols;
+		for(std::size_t c = 0; c < class_of.size(); c++)
+			if(class_of[c] != Constants::InvalidColumn && dfa.synchronizedState(class_of[c]) != Constants::InvalidState)
+				symbols.push_back(static_cast<Symbol>(c));
+		return symbols;
+	}
+public:
+	CompiledBimachineWithFinalOutput(const std::vector<ContextualReplacementRuleRepresentation>& batch, std::optional<Symbol> others_like = std::nullopt):
+		CompiledBimachineWithFinalOutput(BimachineWithFinalOutput{batch}, others_like) {}
+	CompiledBimachineWithFinalOutput(std::vector<ContextualReplacementRuleRepresentation>&& batch, std::optional<Symbol> others_like = std::nullopt):
+		CompiledBimachineWithFinalOutput(BimachineWithFinalOutput{std::move(batch)}, others_like) {}
+	// If others_like is given, the symbols outside the alphabet are not rejected: both automata read them as *others_like, and the output
+	// for such a symbol is the output for *others_like with every *others_like in it replaced by the symbol. E.g. with a delimiter which
+	// the rules never rewrite, any other symbol is output unchanged and ends a word, so unfiltered text can be processed in one pass.
+	// Others whose outputs come out the same share the class of *others_like. Throws std::invalid_argument if *others_like is not in the alphabet.
+	CompiledBimachineWithFinalOutput(const BimachineWithFinalOutput& bm, std::optional<Symbol> others_like = std::nullopt)
+	{
+		const State left_states_cnt = bm.left.statesCnt, right_states_cnt = bm.right.statesCnt;
+
+		// a symbol class is determined by the columns of both automata and the slice of psi for the symbol
+		using signature_t = std::tuple<std::vector<State>, std::vector<State>, std::vector<std::uint32_t>>;
+		std::map<signature_t, std::uint32_t> classes;
+		std::vector<const signature_t*> signature_of_class;
+		class_of.fill(Constants::InvalidColumn);
+		// s is read as read_as, which is s itself unless s is outside the alphabet
+		auto add_symbol = [&](Symbol s, Symbol read_as) {
+			signature_t sig;
+			auto& [left_column, right_column, psi_slice] = sig;
+			for(State L = 0; L < left_states_cnt; L++)
+				left_column.push_back(bm.left.successor(L, read_as));
+			for(State R = 0; R < right_states_cnt; R++)
+				right_column.push_back(bm.right.successor(R, read_as));
+			psi_slice.reserve(left_states_cnt * right_states_cnt);
+			for(State L = 0; L < left_states_cnt; L++)
+				for(State R = 0; R < right_states_cnt; R++)
+					if(auto it = bm.psi.find({L, read_as, R}); it != bm.psi.end())
+					{
+						Word output = it->second;
+						std::ranges::replace(output, read_as, s);
+						psi_slice.push_back(outputs.intern(output));
+					}
+					else
+						psi_slice.push_back(OutputPool::Identity);
+			auto [it, inserted] = classes.try_emplace(std::move(sig), classes.size());
+			if(inserted)
+				signature_of_class.push_back(&it->first);
+			class_of[static_cast<USymbol>(s)] = it->second;
+		};
+		for(Symbol s : bm.left.alphabet)
+			if(bm.right.alphabetOrder.contains(s)) // otherwise the original bimachine cannot be applied on s either
+				add_symbol(s, s);
+		if(others_like)
+		{
+			if(class_of[static_cast<USymbol>(*others_like)] == Constants::InvalidColumn)
+				throw std::invalid_argument("the symbol which the others are read as is not in the alphabet");
+			for(std::size_t c = 0; c < class_of.size(); c++)
+				if(class_of[c] == Constants::InvalidColumn)
+					add_symbol(static_cast<Symbol>(c), *others_like);
+		}
+		classes_cnt = classes.size();
+
+		// the tables of both automata are built from the columns in the signatures, since the symbols outside the alphabet have no transitions
+		std::vector<State> left_table(static_cast<std::size_t>(left_states_cnt) * classes_cnt), right_table(static_cast<std::size_t>(right_states_cnt) * classes_cnt);
+		for(std::uint32_t c = 0; c < classes_cnt; c++)
+		{
+			const auto& [left_column, right_column, psi_slice] = *signature_of_class[c];
+			for(State L = 0; L < left_states_cnt; L++)
+				left_table[L * classes_cnt + c] = left_column[L];
+			for(State R = 0; R < right_states_cnt; R++)
+				right_table[R * classes_cnt + c] = right_column[R];
+		}
+		left = DenseDFA(class_of, classes_cnt, left_states_cnt, *bm.left.initial.begin(), std::move(left_table));
+		right = DenseDFA(class_of, classes_cnt, right_states_cnt, *bm.right.initial.begin(), std::move(right_table));
+		psi.resize(static_cast<std::size_t>(left_states_cnt) * classes_cnt * right_states_cnt);
+		for(std::uint32_t c = 0; c < classes_cnt; c++)
+		{
+			const auto& psi_slice = std::get<2>(*signature_of_class[c]);
+			for(State L = 0; L < left_states_cnt; L++)
+				for(State R = 0; R < right_states_cnt; R++)
+					psi[psi_index(L, c, R)] = psi_slice[L * right_states_cnt + R];
+		}
+
+		std::uint32_t empty = outputs.intern({});
+		iota.assign(left_states_cnt, empty);
+		for(const auto& [L, ret] : bm.iota)
+			iota[L] = outputs.intern(ret);
+		find_always_identity();
+		in_place = output_never_ahead();
+	}
+	// right_path is scratch space; passing the same vector to successive calls avoids reallocating it
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink, std::vector<State>& right_path) const
+	{
+		right.findPath(std::views::reverse(input), right_path);
+		State curr_left_st = apply_left_pass(input, left.initial(), [&](std::size_t j) { return right_path[input.size() - 1 - j]; }, sink);
+		sink.append(outputs[iota[curr_left_st]]);
+	}
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink) const
+	{
+		std::vector<State> right_path;
+		(*this)(input, sink, right_path);
+	}
+	Word operator()(const Word& input) const
+	{
+		Word output;
+		output.reserve(input.size());
+		(*this)(std::string_view{input}, output);
+		return output;
+	}
+
+	// Replaces text with the output of operator() for it. If the output is never ahead of the input (see InPlace), it is written over text
+	// while reading it, so no second buffer is needed; otherwise it is built in a temporary buffer.
+	void apply_in_place(Word& text, std::vector<State>& right_path) const
+	{
+		if(!in_place)
+		{
+			Word output;
+			output.reserve(text.size());
+			(*this)(std::string_view{text}, output, right_path);
+			text = std::move(output);
+			return;
+		}
+		right.findPath(std::views::reverse(text), right_path);
+		SpanSink sink(text);
+		State curr_left_st = apply_left_pass(text, left.initial(), [&](std::size_t j) { return right_path[text.size() - 1 - j]; }, sink);
+		sink.append(outputs[iota[curr_left_st]]);
+		text.resize(sink.size());
+	}
+	void apply_in_place(Word& text) const
+	{
+		std::vector<State> right_path;
+		apply_in_place(text, right_path);
+	}
+
+	// Overwrites edits with the edit script which turns input into the output of operator() (see editScript.hpp), where input is the concatenation
+	// of pieces, e.g. pieces of the original input of a cascade and of the replacements of the previous stages (see edited_pieces).
+	// Only the positions where psi is not the identity and the final output produce edits, so their size depends on the number of changes only.
+	void find_edits(std::span<const std::string_view> pieces, std::vector<Edit>& edits, std::vector<State>& right_path) const
+	{
+		edits.clear();
+		std::size_t n = 0;
+		for(std::string_view piece : pieces)
+			n += piece.size();
+		right_path.resize(n + 1); // right_path[n - 1 - j] is the state of the right automaton used at position j
+		right.withNext([&](auto next_right) {
+			State curr_right_st = right_path[0] = right.initial();
+			std::size_t k = 0;
+			for(std::string_view piece : pieces | std::views::reverse)
+				for(Symbol s : piece | std::views::reverse)
+					right_path[++k] = curr_right_st = next_right(curr_right_st, right.column(s));
+		});
+		State curr_left_st = left.withNext([&](auto next_left) {
+			State curr_left_st = left.initial();
+			std::size_t j = 0;
+			for(std::string_view piece : pieces)
+				for(std::size_t i = 0; i < piece.size(); i++, j++)
+				{
+					std::uint32_t c = class_of[static_cast<USymbol>(piece[i])]; // already validated by the right pass
+					if(!always_identity[curr_left_st * classes_cnt + c])
+						if(std::uint32_t out = psi[psi_index(curr_left_st, c, right_path[n - 1 - j])]; out != OutputPool::Identity)
+							if(std::string_view output = outputs[out]; output != piece.substr(i, 1))
+								add_edit(edits, j, 1, output);
+					curr_left_st = next_left(curr_left_st, c);
+				}
+			return curr_left_st;
+		});
+		if(std::string_view output = outputs[iota[curr_left_st]]; !output.empty())
+			add_edit(edits, n, 0, output);
+	}
+	void find_edits(std::string_view input, std::vector<Edit>& edits, std::vector<State>& right_path) const
+	{
+		find_edits(std::span<const std::string_view>(&input, 1), edits, right_path);
+	}
+	std::vector<Edit> find_edits(std::string_view input) const
+	{
+		std::vector<Edit> edits;
+		std::vector<State> right_path;
+		find_edits(input, edits, right_path);
+		return edits;
+	}
+
+	// Applies the bimachine independently on each of the words inputs[offsets[i], offsets[i + 1]) and appends the results to results.
+	// result_offsets receives their offsets in the same layout, i.e. the i-th result is results[result_offsets[i], result_offsets[i + 1]).
+	// Both passes run over blocks of consecutive words which fit in the cache, and right_path is the only scratch space; it is reused across calls.
+	void apply_batch(std::string_view inputs, std::span<const std::size_t> offsets, Word& results, std::vector<std::size_t>& result_offsets, std::vector<State>& right_path) const
+	{
+		constexpr std::size_t block_size = 1 << 14;
+		result_offsets.clear();
+		if(offsets.empty())
+			return;
+		results.reserve(results.size() + (offsets.back() - offsets.front()));
+		result_offsets.reserve(offsets.size());
+		result_offsets.push_back(results.size());
+		for(std::size_t block_begin = 0, block_end; block_begin + 1 < offsets.size(); block_begin = block_end)
+		{
+			block_end = block_begin + 1;
+			while(block_end + 1 < offsets.size() && offsets[block_end + 1] - offsets[block_begin] <= block_size)
+				block_end++;
+
+			const std::size_t begin = offsets[block_begin];
+			right_path.resize(offsets[block_end] - begin); // right_path[j - begin] is the state of the right automaton used at position j
+			for(std::size_t word = block_end; word-- > block_begin;)
+			{
+				State curr_right_st = right.initial();
+				for(std::size_t j = offsets[word + 1]; j-- > offsets[word];)
+				{
+					right_path[j - begin] = curr_right_st;
+					curr_right_st = right.successor(curr_right_st, inputs[j]);
+				}
+			}
+
+			for(std::size_t word = block_begin; word < block_end; word++)
+			{
+				const std::size_t word_begin = offsets[word] - begin;
+				State curr_left_st = apply_left_pass(inputs.substr(offsets[word], offsets[word + 1] - offsets[word]), left.initial(),
+					[&](std::size_t j) { return right_path[word_begin + j]; }, results);
+				results += outputs[iota[curr_left_st]];
+				result_offsets.push_back(results.size());
+			}
+		}
+	}
+	void apply_batch(std::string_view inputs, std::span<const std::size_t> offsets, Word& results, std::vector<std::size_t>& result_offsets) const
+	{
+		std::vector<State> right_path;
+		apply_batch(inputs, offsets, results, result_offsets, right_path);
+	}
+
+	// Applies the bimachine independently on each of inputs, appending the result for inputs[i] to sinks[i]. The inputs, e.g. separate documents,
+	// are run in lockstep by both automata (see DenseDFA::findPaths), which hides the latency of their transitions.
+	// paths is scratch space holding the paths of both automata; it is reused across calls.
+	template<OutputSink Sink>
+	void apply_interleaved(std::span<const std::string_view> inputs, std::span<Sink> sinks, std::vector<std::vector<State>>& paths) const
+	{
+		if(inputs.size() != sinks.size())
+			throw std::invalid_argument("the numbers of inputs and sinks differ");
+		paths.resize(2 * inputs.size());
+		std::span<std::vector<State>> right_paths(paths.data(), inputs.size()), left_paths(paths.data() + inputs.size(), inputs.size());
+		right.findPaths(inputs, true, right_paths);
+		left.findPaths(inputs, false, left_paths); // already validated by the right automaton
+		for(std::size_t i = 0; i < inputs.size(); i++)
+		{
+			// all states are known, so the lookups in psi do not depend on each other
+			std::string_view input = inputs[i];
+			const std::vector<State>& left_path = left_paths[i];
+			const std::vector<State>& right_path = right_paths[i]; // right_path[input.size() - 1 - j] is the state used at position j
+			for(std::size_t j = 0; j < input.size(); j++)
+			{
+				std::uint32_t c = class_of[static_cast<USymbol>(input[j])];
+				if(std::uint32_t out = psi[psi_index(left_path[j], c, right_path[input.size() - 1 - j])]; out == OutputPool::Identity)
+					sinks[i].push_back(input[j]);
+				else
+					sinks[i].append(outputs[out]);
+			}
+			sinks[i].append(outputs[iota[left_path[input.size()]]]);
+		}
+	}
+	template<OutputSink Sink>
+	void apply_interleaved(std::span<const std::string_view> inputs, std::span<Sink> sinks) const
+	{
+		std::vector<std::vector<State>> paths;
+		apply_interleaved(inputs, sinks, paths);
+	}
+
+	// Appends to sink the output which operator() produces for the positions begin, begin + 1, ..., end - 1 of input
+	// (and the final output if end == input.size()), so the outputs of consecutive segments concatenate to the output for input.
+	// The states at the boundaries are found by reading input only up to the nearest synchronizing symbols.
+	template<OutputSink Sink>
+	void apply_segment(std::string_view input, std::size_t begin, std::size_t end, Sink& sink, std::vector<State>& right_path) const
+	{
+		if(begin > end || end > input.size())
+			throw std::out_of_range("invalid segment");
+		State curr_left_st = apply_between(input.substr(begin, end - begin), left_state_at(input, begin), right_state_at(input, end), sink, right_path);
+		if(end == input.size())
+			final_output(curr_left_st, sink);
+	}
+	// Appends to sink the output for the symbols of input when the left automaton is in curr_left_st before input
+	// and the right automaton is in curr_right_st after reading what follows input reversed. Returns the state of the left automaton after input.
+	template<OutputSink Sink>
+	State apply_between(std::string_view input, State curr_left_st, State curr_right_st, Sink& sink, std::vector<State>& right_path) const
+	{
+		right_path.resize(input.size()); // right_path[j] is the state of the right automaton used at position j
+		for(std::size_t j = input.size(); j-- > 0;)
+		{
+			right_path[j] = curr_right_st;
+			curr_right_st = right.successor(curr_right_st, input[j]);
+		}
+		return apply_left_pass(input, curr_left_st, [&](std::size_t j) { return right_path[j]; }, sink);
+	}
+	// appends the output for s when the left automaton is in curr_left_st before s and the right automaton is in curr_right_st after it;
+	// returns the state of the left automaton after s
+	template<OutputSink Sink>
+	State apply_symbol(Symbol s, State curr_left_st, State curr_right_st, Sink& sink) const
+	{
+		std::uint32_t c = left.column(s);
+		if(std::uint32_t out = psi[psi_index(curr_left_st, c, curr_right_st)]; out == OutputPool::Identity)
+			sink.push_back(s);
+		else
+			sink.append(outputs[out]);
+		return left.next(curr_left_st, c);
+	}
+	// appends the output at the end of the input, when the left automaton is in curr_left_st
+	void final_output(State curr_left_st, OutputSink auto& sink) const
+	{
+		sink.append(outputs[iota[curr_left_st]]);
+	}
+	State left_initial() const noexcept { return left.initial(); }
+	State right_initial() const noexcept { return right.initial(); }
+	State right_successor(State curr_right_st, Symbol s) const { return right.successor(curr_right_st, s); }
+	// the right states at the ends of the blocks of input, when the right automaton is in curr_right_st after what follows input reversed
+	// (see DenseDFA::findCheckpointsReversed)
+	template<class BlockBegin>
+	State right_checkpoints(std::string_view input, State curr_right_st, std::span<State> checkpoints, BlockBegin block_begin) const
+	{
+		return right.findCheckpointsReversed(input, curr_right_st, checkpoints, block_begin);
+	}
+	// the state of the left automaton after reading input from curr_left_st
+	State left_successor(State curr_left_st, std::string_view input) const
+	{
+		return left.withNext([&](auto next_left) {
+			for(Symbol s : input)
+				curr_left_st = next_left(curr_left_st, left.column(s));
+			return curr_left_st;
+		});
+	}
+	// the state of the left automaton after s regardless of the history, or Constants::InvalidState if s is not left-synchronizing
+	State left_synchronized_state(Symbol s) const { return left.synchronizedState(left.column(s)); }
+	// the state of the right automaton after s regardless of the rest of the input, or Constants::InvalidState if s is not right-synchronizing
+	State right_synchronized_state(Symbol s) const { return right.synchronizedState(right.column(s)); }
+
+	// symbols after which the state of the left automaton does not depend on what was read before them
+	Word left_synchronizing_symbols() const { return symbols_of(class_of, left); }
+	// symbols after which the state of the right automaton does not depend on what was read before them, i.e. on the rest of the input
+	Word right_synchronizing_symbols() const { return symbols_of(class_of, right); }
+	// The number of symbols after a position which determine the output for it, whatever follows them, or std::nullopt if there is no such bound.
+	// The right automaton reads these symbols last, so this is the lookahead of the right automaton with respect to the columns of psi (see DenseDFA::lookahead).
+	// Throws std::length_error if more than max_sets sets of right states are needed.
+	std::optional<std::size_t> lookahead(std::size_t max_sets = 1 << 16) const
+	{
+		// right states with equal columns of psi give the same output in every context
+		std::vector<State> column_of(right.states());
+		std::map<std::vector<std::uint32_t>, State> index_of;
+		for(State R = 0; R < right.states(); R++)
+		{
+			std::vector<std::uint32_t> column;
+			for(State L = 0; L < left.states(); L++)
+				for(std::uint32_t c = 0; c < classes_cnt; c++)
+					column.push_back(psi[psi_index(L, c, R)]);
+			column_of[R] = index_of.try_emplace(std::move(column), index_of.size()).first->second;
+		}
+		return right.lookahead(std::move(column_of), max_sets);
+	}
+	// whether input can be split into segments whose boundary states are found locally; otherwise finding them may need to read the whole input
+	bool splittable() const
+	{
+		return !left_synchronizing_symbols().empty() && !right_synchronizing_symbols().empty();
+	}
+	// The bimachine is local between delimiters if it can be applied on every token ending with a delimiter independently:
+	// for every input x ending with a delimiter and every input y, the output for xy is the output for x followed by the output for y
+	// when the left automaton starts in a fixed state S, and the output for x ends with a delimiter. Returns S if the bimachine is local, otherwise std::nullopt.
+	// This is checked by sufficient conditions: every delimiter synchronizes both automata, the left one into S, the output for a delimiter does not depend
+	// on the right state and ends with a delimiter, and the final output in S is empty. Delimiters outside the alphabet are ignored, since no valid input contains them.
+	std::optional<State> token_left_state(std::string_view delimiters) const
+	{
+		std::array<bool, std::numeric_limits<USymbol>::max() + 1> is_delimiter{};
+		for(Symbol d : delimiters)
+			is_delimiter[static_cast<USymbol>(d)] = true;
+		std::optional<State> S;
+		for(Symbol d : delimiters)
+		{
+			std::uint32_t c = class_of[static_cast<USymbol>(d)];
+			if(c == Constants::InvalidColumn)
+				continue;
+			if(S.value_or(left.synchronizedState(c)) != left.synchronizedState(c) || left.synchronizedState(c) == Constants::InvalidState ||
+				right.synchronizedState(c) == Constants::InvalidState)
+				return std::nullopt;
+			S = left.synchronizedState(c);
+			for(State L = 0; L < left.states(); L++)
+			{
+				std::uint32_t out = psi[psi_index(L, c, 0)];
+				for(State R = 1; R < right.states(); R++)
+					if(psi[psi_index(L, c, R)] != out)
+						return std::nullopt;
+				if(out != OutputPool::Identity && (outputs[out].empty() || !is_delimiter[static_cast<USymbol>(outputs[out].back())]))
+					return std::nullopt;
+			}
+		}
+		if(!S || !outputs[iota[*S]].empty())
+			return std::nullopt;
+		return S;
+	}
+	bool local_between(std::string_view delimiters) const
+	{
+		return token_left_state(delimiters).has_value();
+	}
+	// Splits input into chunks_cnt chunks (pool.size() if 0), applies the bimachine on them in parallel and concatenates the results.
+	// The output is the same as the output of operator(). Returns std::nullopt if the bimachine is not splittable; then operator() should be used instead.
+	// This may be called from a task of pool.
+	std::optional<Word> apply_parallel(std::string_view input, ThreadPool& pool, std::size_t chunks_cnt = 0) const
+	{
+		if(!splittable())
+			return std::nullopt;
+		if(!chunks_cnt)
+			chunks_cnt = pool.size();
+		chunks_cnt = std::max<std::size_t>(1, std::min(chunks_cnt, input.size()));
+		std::vector<std::future<Word>> chunks;
+		chunks.reserve(chunks_cnt);
+		for(std::size_t i = 0; i < chunks_cnt; i++)
+			chunks.push_back(pool.submit([this, input, begin = input.size() * i / chunks_cnt, end = input.size() * (i + 1) / chunks_cnt] {
+				Word output;
+				output.reserve(end - begin);
+				std::vector<State> right_path;
+				apply_segment(input, begin, end, output, right_path);
+				return output;
+			}));
+		Word output;
+		output.reserve(input.size());
+		for(const Word& chunk_output : wait_all(chunks, pool))
+			output += chunk_output;
+		return output;
+	}
+
+	// Same output as operator(), but the right path is not stored whole: the reversed pass keeps only the right state at the end of every block
+	// of block_size symbols, and each block's right states are recomputed from it before its forward pass. This takes about twice the work
+	// of the right automaton and n / block_size + block_size states of memory instead of n + 1.
+	template<OutputSink Sink>
+	void apply_checkpointed(std::string_view input, Sink& sink, std::size_t block_size = 1 << 12) const
+	{
+		if(!block_size)
+			throw std::invalid_argument("the block size must be positive");
+		const std::size_t blocks_cnt = (input.size() + block_size - 1) / block_size;
+		std::vector<State> checkpoints(blocks_cnt); // checkpoints[b] is the right state after reading the input after block b reversed
+		right.findCheckpointsReversed(input, right.initial(), checkpoints, [&](std::size_t b) { return std::min(b * block_size, input.size()); });
+		std::vector<State> right_path;
+		State curr_left_st = left.initial();
+		for(std::size_t b = 0; b < blocks_cnt; b++)
+			curr_left_st = apply_between(input.substr(b * block_size, block_size), curr_left_st, checkpoints[b], sink, right_path);
+		final_output(curr_left_st, sink);
+	}
+
+	// Same output as operator(), for any bimachine. The right path is found by the enumerative parallel run of the right automaton,
+	// and the left automaton is run in the same way together with the output loop (see parallel_run). chunks_cnt is pool.size() if 0.
+	Word apply_enumerative(std::string_view input, ThreadPool& pool, std::size_t chunks_cnt = 0) const
+	{
+		std::vector<State> right_path;
+		right.findPath(std::views::reverse(input), right_path, pool, chunks_cnt);
+		chunks_cnt = chunks_cnt_for(input.size(), chunks_cnt, pool);
+		std::vector<Word> chunk_outputs(chunks_cnt);
+		State last_left_st = left.initial();
+		parallel_run(left.states(), left.initial(), input.size(),
+			[this, input](State L, std::size_t pos) { return left.next(L, class_of[static_cast<USymbol>(input[pos])]); }, // already validated by the right pass
+			[&](std::size_t i, std::size_t begin, std::size_t end, State curr_left_st) {
+				Word& output = chunk_outputs[i];
+				output.reserve(end - begin);
+				for(std::size_t j = begin; j < end; j++)
+				{
+					std::uint32_t c = class_of[static_cast<USymbol>(input[j])];
+					if(std::uint32_t out = psi[psi_index(curr_left_st, c, right_path[input.size() - 1 - j])]; out == OutputPool::Identity)
+						output.push_back(input[j]);
+					else
+						output += outputs[out];
+					curr_left_st = left.next(curr_left_st, c);
+				}
+				if(end == input.size())
+					last_left_st = curr_left_st;
+			}, pool, chunks_cnt);
+		Word output;
+		output.reserve(input.size());
+		for(const Word& chunk_output : chunk_outputs)
+			output += chunk_output;
+		output += outputs[iota[last_left_st]];
+		return output;
+	}
+
+	std::uint32_t ClassesCnt() const noexcept { return classes_cnt; }
+	State LeftStatesCnt() const noexcept { return left.states(); }
+	State RightStatesCnt() const noexcept { return right.states(); }
+	// whether apply_in_place writes the output over the input
+	bool InPlace() const noexcept { return in_place; }
+};
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef COMPILED_TWOSTEPBIMACHINE_HPP
+#define COMPILED_TWOSTEPBIMACHINE_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <ranges>
+#include <optional>
+#include <stdexcept>
+#include <algorithm>
+#include "twostepBimachine.hpp"
+#include "denseDFA.hpp"
+#include "outputPool.hpp"
+#include "outputSink.hpp"
+#include "threadPool.hpp"
+#include "parallelRun.hpp"
+#include "constants.hpp"
+
+// the rule with number rule in the batch is applied on the input from position on
+struct RuleMatch
+{
+	std::size_t position;
+	std::uint32_t rule;
+
+	friend bool operator==(const RuleMatch&, const RuleMatch&) = default;
+};
+
+// Frozen form of TwostepBimachine. delta and psi_delta are stored as dense (q, class, R) tables and tau and psi_tau as dense (L, R) tables;
+// q_err is used as the sentinel for undefined delta and tau. The left automaton is run together with the output loop, so only the right path is stored.
+class CompiledTwostepBimachine
+{
+	DenseDFA::ColumnMap class_of; // class_of[c] == Constants::InvalidColumn <=> c is not in the alphabet
+	std::uint32_t classes_cnt = 0;
+	DenseDFA left, right; // both use the symbol classes as columns
+	State q_err = 0; // the states of the center transducer are 0, 1, ..., q_err - 1
+	std::vector<State> delta; // [q][class][R] -> q' or q_err
+	std::vector<std::uint32_t> psi_delta; // [q][class][R] -> output id or OutputPool::Identity
+	std::vector<State> tau; // [L][R] -> q or q_err
+	std::vector<std::uint32_t> psi_tau; // [L][R] -> output id
+	std::vector<bool> final_center; // [q], q_err included
+	std::vector<std::uint32_t> rule_of_jump; // [L][R] -> the rule applied by epsilon_jump(L, R) or Constants::InvalidRule
+	std::uint32_t rules_cnt = 0;
+	OutputPool outputs;
+
+	std::size_t delta_index(State q, std::uint32_t c, State R) const noexcept
+	{
+		return (static_cast<std::size_t>(q) * classes_cnt + c) * right.states() + R;
+	}
+	std::size_t tau_index(State L, State R) const noexcept
+	{
+		return static_cast<std::size_t>(L) * right.states() + R;
+	}
+	State epsilon_jump(State L, State R, OutputSink auto& sink) const
+	{
+		State curr = tau[tau_index(L, R)];
+		if(curr == q_err)
+			sink.append(outputs[psi_tau[tau_index(L, R)]]);
+		return curr;
+	}
+	// epsilon_jump without output; calls on_match(position, rule) if a rule is applied from position on
+	template<class F>
+	State match_jump(State L, State R, std::size_t position, F& on_match) const
+	{
+		if(std::uint32_t rule = rule_of_jump[tau_index(L, R)]; rule != Constants::InvalidRule)
+			on_match(position, rule);
+		return tau[tau_index(L, R)];
+	}
+	// the transitions of step without output; position is the one after the symbol
+	template<class F>
+	State match_step(State curr, std::uint32_t c, State L, State R, std::size_t position, F& on_match) const
+	{
+		if(curr != q_err)
+		{
+			State next = delta[delta_index(curr, c, R)];
+			if(!final_center[next])
+				return next;
+		}
+		return match_jump(L, R, position, on_match);
+	}
+	// processes the symbol s of class c, where L is the state of the left automaton after s and R is the state of the right automaton before it
+	template<OutputSink Sink>
+	State step(State curr, Symbol s, std::uint32_t c, State L, State R, Sink& sink) const
+	{
+		if(curr != q_err)
+		{
+			State next = delta[delta_index(curr, c, R)];
+			if(std::uint32_t out = psi_delta[delta_index(curr, c, R)]; out == OutputPool::Identity)
+				sink.push_back(s);
+			else
+				sink.append(outputs[out]);
+			return final_center[next] ? epsilon_jump(L, R, sink) : next;
+		}
+		sink.push_back(s);
+		return epsilon_jump(L, R, sink);
+	}
+public:
+	CompiledTwostepBimachine(const std::vector<ContextualReplacementRuleRepresentation>& batch, std::optional<Symbol> others_like = std::nullopt):
+		CompiledTwostepBimachine(TwostepBimachine{batch}, others_like) {}
+	CompiledTwostepBimachine(std::vector<ContextualReplacementRuleRepresentation>&& batch, std::optional<Symbol> others_like = std::nullopt):
+		CompiledTwostepBimachine(TwostepBimachine{std::move(batch)}, others_like) {}
+	// others_like is as in CompiledBimachineWithFinalOutput: the symbols outside the alphabet are read as *others_like,
+	// and every *others_like in the outputs of psi_delta for them is replaced by the symbol
+	CompiledTwostepBimachine(const TwostepBimachine& bm, std::optional<Symbol> others_like = std::nullopt)
+	{
+		const State left_states_cnt = bm.left.statesCnt, right_states_cnt = bm.right.statesCnt;
+		q_err = bm.q_err;
+
+		// the entries of delta and psi_delta, grouped by symbol
+		using delta_slice_t = std::vector<std::tuple<State, State, State>>; // (q, R, delta(q, a, R))
+		using psi_delta_slice_t = std::vector<std::tuple<State, State, std::uint32_t>>; // (q, R, psi_delta(q, a, R))
+		std::map<USymbol, delta_slice_t> delta_of_symbol;
+		std::map<USymbol, psi_delta_slice_t> psi_delta_of_symbol;
+		for(const auto& [args, ret] : bm.delta)
+		{
+			const auto& [q, a, R] = args;
+			delta_of_symbol[static_cast<USymbol>(a)].emplace_back(q, R, ret);
+		}
+		for(const auto& [args, ret] : bm.psi_delta)
+		{
+			const auto& [q, a, R] = args;
+			psi_delta_of_symbol[static_cast<USymbol>(a)].emplace_back(q, R, outputs.intern(ret));
+		}
+
+		// a symbol class is determined by the columns of both automata and the slices of delta and psi_delta for the symbol
+		using signature_t = std::tuple<std::vector<State>, std::vector<State>, delta_slice_t, psi_delta_slice_t>;
+		std::map<signature_t, std::uint32_t> classes;
+		std::vector<const signature_t*> signature_of_class;
+		class_of.fill(Constants::InvalidColumn);
+		// s is read as read_as, which is s itself unless s is outside the alphabet
+		auto add_symbol = [&](Symbol s, Symbol read_as) {
+			signature_t sig;
+			auto& [left_column, right_column, delta_slice, psi_delta_slice] = sig;
+			for(State L = 0; L < left_states_cnt; L++)
+				left_column.push_back(bm.left.successor(L, read_as));
+			for(State R = 0; R < right_states_cnt; R++)
+				right_column.push_back(bm.right.successor(R, read_as));
+			delta_slice = delta_of_symbol[read_as];
+			std::ranges::sort(delta_slice);
+			psi_delta_slice = psi_delta_of_symbol[read_as];
+			if(s != read_as)
+				for(auto& [q, R, out] : psi_delta_slice)
+				{
+					Word output{outputs[out]};
+					std::ranges::replace(output, read_as, s);
+					out = outputs.intern(output);
+				}
+			std::ranges::sort(psi_delta_slice);
+			auto [it, inserted] = classes.try_emplace(std::move(sig), classes.size());
+			if(inserted)
+				signature_of_class.push_back(&it->first);
+			class_of[static_cast<USymbol>(s)] = it->second;
+		};
+		for(Symbol s : bm.left.alphabet)
+			if(bm.right.alphabetOrder.contains(s)) // otherwise the original bimachine cannot be applied on s either
+				add_symbol(s, s);
+		if(others_like)
+		{
+			if(class_of[static_cast<USymbol>(*others_like)] == Constants::InvalidColumn)
+				throw std::invalid_argument("the symbol which the others are read as is not in the alphabet");
+			for(std::size_t c = 0; c < class_of.size(); c++)
+				if(class_of[c] == Constants::InvalidColumn)
+					add_symbol(static_cast<Symbol>(c), *others_like);
+		}
+		classes_cnt = classes.size();
+
+		// the tables of both automata are built from the columns in the signatures, since the symbols outside the alphabet have no transitions
+		std::vector<State> left_table(static_cast<std::size_t>(left_states_cnt) * classes_cnt), right_table(static_cast<std::size_t>(right_states_cnt) * classes_cnt);
+		for(std::uint32_t c = 0; c < classes_cnt; c++)
+		{
+			const auto& [left_column, right_column, delta_slice, psi_delta_slice] = *signature_of_class[c];
+			for(State L = 0; L < left_states_cnt; L++)
+				left_table[L * classes_cnt + c] = left_column[L];
+			for(State R = 0; R < right_states_cnt; R++)
+				right_table[R * classes_cnt + c] = right_column[R];
+		}
+		left = DenseDFA(class_of, classes_cnt, left_states_cnt, *bm.left.initial.begin(), std::move(left_table));
+		right = DenseDFA(class_of, classes_cnt, right_states_cnt, *bm.right.initial.begin(), std::move(right_table));
+		delta.assign(static_cast<std::size_t>(q_err) * classes_cnt * right_states_cnt, q_err);
+		psi_delta.assign(delta.size(), OutputPool::Identity);
+		for(std::uint32_t c = 0; c < classes_cnt; c++)
+		{
+			const auto& [left_column, right_column, delta_slice, psi_delta_slice] = *signature_of_class[c];
+			for(auto [q, R, next] : delta_slice)
+				delta[delta_index(q, c, R)] = next;
+			for(auto [q, R, out] : psi_delta_slice)
+				psi_delta[delta_index(q, c, R)] = out;
+		}
+
+		tau.assign(static_cast<std::size_t>(left_states_cnt) * right_states_cnt, q_err);
+		psi_tau.assign(tau.size(), outputs.intern({}));
+		for(const auto& [args, ret] : bm.tau)
+		{
+			const auto& [L, R] = args;
+			tau[tau_index(L, R)] = ret;
+		}
+		for(const auto& [args, ret] : bm.psi_tau)
+		{
+			const auto& [L, R] = args;
+			psi_tau[tau_index(L, R)] = outputs.intern(ret);
+		}
+
+		final_center.resize(q_err + 1);
+		for(State q : bm.final_center)
+			final_center[q] = true;
+
+		rules_cnt = bm.rules_cnt;
+		rule_of_jump.assign(tau.size(), Constants::InvalidRule);
+		for(State L = 0; L < left_states_cnt; L++)
+			for(State R = 0; R < right_states_cnt; R++)
+				if(State init = tau[tau_index(L, R)]; init != q_err)
+					rule_of_jump[tau_index(L, R)] = bm.rule_of_center[init];
+		for(const auto& [args, rule] : bm.epsilon_rule)
+		{
+			const auto& [L, R] = args;
+			rule_of_jump[tau_index(L, R)] = rule;
+		}
+	}
+	// right_path is scratch space; passing the same vector to successive calls avoids reallocating it
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink, std::vector<State>& right_path) const
+	{
+		right.findPath(std::views::reverse(input), right_path);
+		auto right_path_rev_it = right_path.rbegin();
+
+		left.withNext([&](auto next_left) {
+			State L = left.initial();
+			State curr = epsilon_jump(L, *right_path_rev_it, sink);
+			for(Symbol s : input)
+			{
+				std::uint32_t c = class_of[static_cast<USymbol>(s)]; // already validated by findPath
+				L = next_left(L, c);
+				curr = step(curr, s, c, L, *++right_path_rev_it, sink);
+			}
+		});
+	}
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink) const
+	{
+		std::vector<State> right_path;
+		(*this)(input, sink, right_path);
+	}
+	Word operator()(const Word& input) const
+	{
+		Word output;
+		output.reserve(input.size());
+		(*this)(std::string_view{input}, output);
+		return output;
+	}
+
+	// Same output as operator(), but the right path is not stored whole: the reversed pass keeps only the right state at the end of every block
+	// of block_size symbols, and each block's right states are recomputed from it before its forward pass. This takes about twice the work
+	// of the right automaton and n / block_size + block_size states of memory instead of n + 1.
+	template<OutputSink Sink>
+	void apply_checkpointed(std::string_view input, Sink& sink, std::size_t block_size = 1 << 12) const
+	{
+		if(!block_size)
+			throw std::invalid_argument("the block size must be positive");
+		const std::size_t blocks_cnt = (input.size() + block_size - 1) / block_size;
+		std::vector<State> checkpoints(blocks_cnt); // checkpoints[b] is the right state after reading the input after block b reversed
+		State curr_right_st = right.findCheckpointsReversed(input, right.initial(), checkpoints, [&](std::size_t b) { return std::min(b * block_size, input.size()); });
+
+		std::vector<State> right_path; // right_path[j] is the right state after the symbol at position j of the block
+		State L = left.initial();
+		State curr = epsilon_jump(L, curr_right_st, sink);
+		for(std::size_t b = 0; b < blocks_cnt; b++)
+		{
+			std::string_view block = input.substr(b * block_size, block_size);
+			right_path.resize(block.size());
+			curr_right_st = checkpoints[b];
+			for(std::size_t j = block.size(); j-- > 0;)
+			{
+				right_path[j] = curr_right_st;
+				curr_right_st = right.next(curr_right_st, class_of[static_cast<USymbol>(block[j])]); // already validated by the reversed pass
+			}
+			for(std::size_t j = 0; j < block.size(); j++)
+			{
+				std::uint32_t c = class_of[static_cast<USymbol>(block[j])];
+				L = left.next(L, c);
+				curr = step(curr, block[j], c, L, right_path[j], sink);
+			}
+		}
+	}
+
+	// Same output as operator(). Both automata are run by the enumerative parallel run (see parallel_run),
+	// and then the center transducer is run in the same way together with the output loop. chunks_cnt is pool.size() if 0.
+	Word apply_enumerative(std::string_view input, ThreadPool& pool, std::size_t chunks_cnt = 0) const
+	{
+		std::vector<State> left_path, right_path;
+		right.findPath(std::views::reverse(input), right_path, pool, chunks_cnt);
+		left.findPath(input, left_path, pool, chunks_cnt);
+		auto R_at = [&](std::size_t pos) { return right_path[input.size() - 1 - pos]; }; // the state of the right automaton before input[pos]
+		chunks_cnt = chunks_cnt_for(input.size(), chunks_cnt, pool);
+		std::vector<Word> chunk_outputs(chunks_cnt);
+		CountingSink no_output;
+		State initial = epsilon_jump(left.initial(), right_path.back(), no_output);
+		parallel_run(q_err + 1, initial, input.size(),
+			[&](State curr, std::size_t pos) {
+				CountingSink no_output;
+				return step(curr, input[pos], class_of[static_cast<USymbol>(input[pos])], left_path[pos + 1], R_at(pos), no_output);
+			},
+			[&](std::size_t i, std::size_t begin, std::size_t end, State curr) {
+				Word& output = chunk_outputs[i];
+				output.reserve(end - begin);
+				if(begin == 0)
+					epsilon_jump(left.initial(), right_path.back(), output);
+				for(std::size_t j = begin; j < end; j++)
+					curr = step(curr, input[j], class_of[static_cast<USymbol>(input[j])], left_path[j + 1], R_at(j), output);
+			}, pool, chunks_cnt);
+		Word output;
+		output.reserve(input.size());
+		for(const Word& chunk_output : chunk_outputs)
+			output += chunk_output;
+		return output;
+	}
+
+	// Finds where operator() would apply the rules without building the output: on_match(position, rule) is called for every application
+	// of a rule on the input from position on, in increasing order of position. Only the center transducer is run besides both automata,
+	// and the output tables are not read at all.
+	template<class F>
+	void find_matches(std::string_view input, F&& on_match, std::vector<State>& right_path) const
+	{
+		right.findPath(std::views::reverse(input), right_path);
+		auto right_path_rev_it = right_path.rbegin();
+
+		left.withNext([&](auto next_left) {
+			State L = left.initial();
+			State curr = match_jump(L, *right_path_rev_it, 0, on_match);
+			for(std::size_t j = 0; j < input.size(); j++)
+			{
+				std::uint32_t c = class_of[static_cast<USymbol>(input[j])]; // already validated by findPath
+				L = next_left(L, c);
+				curr = match_step(curr, c, L, *++right_path_rev_it, j + 1, on_match);
+			}
+		});
+	}
+	std::vector<RuleMatch> find_matches(std::string_view input) const
+	{
+		std::vector<RuleMatch> matches;
+		std::vector<State> right_path;
+		find_matches(input, [&](std::size_t position, std::uint32_t rule) { matches.push_back({position, rule}); }, right_path);
+		return matches;
+	}
+	// adds to counts[rule] the number of applications of the rule on input; counts is extended to RulesCnt() elements if shorter
+	void count_matches(std::string_view input, std::vector<std::size_t>& counts, std::vector<State>& right_path) const
+	{
+		if(counts.size() < rules_cnt)
+			counts.resize(rules_cnt);
+		find_matches(input, [&](std::size_t, std::uint32_t rule) { counts[rule]++; }, right_path);
+	}
+
+	std::uint32_t RulesCnt() const noexcept { return rules_cnt; }
+	std::uint32_t ClassesCnt() const noexcept { return classes_cnt; }
+	State LeftStatesCnt() const noexcept { return left.states(); }
+	State RightStatesCnt() const noexcept { return right.states(); }
+};
+
+#endif
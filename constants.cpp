@@ -6,7 +6,7 @@ namespace Constants
 {
 	namespace Internal
 	{
-		static unsigned char SymbolTable[std::numeric_limits<unsigned char>::max()];
+		static unsigned char SymbolTable[std::numeric_limits<unsigned char>::max() + 1];
 		constexpr unsigned char 	special_mask = 0b0000'0001;
 		constexpr unsigned char	   operator_mask = 0b0000'0010;
 		constexpr unsigned char parenthesis_mask = 0b0000'0100;
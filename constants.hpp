@@ -25,6 +25,7 @@ namespace Constants
 
 	constexpr State InvalidState = -1;
 	constexpr std::uint32_t InvalidRule = -1;
+	constexpr std::uint32_t InvalidColumn = -1;
 
 	constexpr Symbol Epsilon = '_';
 	constexpr Symbol BaseElementBegin = '[';
@@ -40,7 +41,13 @@ namespace Constants
 	constexpr Symbol ReplacementPos = '^';
 	constexpr Symbol ReplacementStart = '<';
 	constexpr Symbol ReplacementEnd = '>';
+	// {a-zà-ÿ} is the union of the code points listed, so a brace outside a base element no longer stands for itself; see RegularExpression.
+	// The braces are not special symbols, so they can still be in an alphabet and in base elements, and {{} and {}} list them.
+	constexpr Symbol RangeBegin = '{';
+	constexpr Symbol RangeEnd = '}';
+	constexpr Symbol RangeDelim = '-';
 	static_assert(BaseElementBegin != BaseElementEnd, "BaseElementBegin and BaseElementEnd must be different");
+	static_assert(RangeBegin != RangeEnd, "RangeBegin and RangeEnd must be different");
 
 	bool isSpecial(USymbol c);
 	bool isOperator(USymbol c);
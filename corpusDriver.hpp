@@ -0,0 +1,202 @@
+#ifndef CORPUSDRIVER_HPP
+#define CORPUSDRIVER_HPP
+
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "constants.hpp"
+
+// Runs f(worker, task) for the tasks 0, 1, ..., tasks_cnt - 1 on workers_cnt threads. Every worker starts with its own contiguous range of tasks
+// and takes them from the front; when it runs out, it steals from the back of the ranges of the other workers.
+// f must not throw.
+template<class F>
+void for_each_stealing(std::size_t tasks_cnt, std::size_t workers_cnt, F f)
+{
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<std::size_t> tasks;
+	};
+	workers_cnt = std::max<std::size_t>(1, std::min(workers_cnt, tasks_cnt));
+	std::vector<Queue> queues(workers_cnt);
+	for(std::size_t w = 0; w < workers_cnt; w++)
+		for(std::size_t task = tasks_cnt * w / workers_cnt; task < tasks_cnt * (w + 1) / workers_cnt; task++)
+			queues[w].tasks.push_back(task);
+
+	auto take = [&](std::size_t w) -> std::optional<std::size_t> {
+		{
+			std::lock_guard lock(queues[w].mutex);
+			if(!queues[w].tasks.empty())
+			{
+				std::size_t task = queues[w].tasks.front();
+				queues[w].tasks.pop_front();
+				return task;
+			}
+		}
+		for(std::size_t i = 1; i < workers_cnt; i++) // no tasks are added, so once all queues are seen empty, the work is done
+		{
+			Queue& victim = queues[(w + i) % workers_cnt];
+			std::lock_guard lock(victim.mutex);
+			if(!victim.tasks.empty())
+			{
+				std::size_t task = victim.tasks.back();
+				victim.tasks.pop_back();
+				return task;
+			}
+		}
+		return std::nullopt;
+	};
+	std::vector<std::jthread> workers;
+	workers.reserve(workers_cnt);
+	for(std::size_t w = 0; w < workers_cnt; w++)
+		workers.emplace_back([&, w] {
+			while(auto task = take(w))
+				f(w, *task);
+		});
+}
+
+struct CorpusFile
+{
+	std::filesystem::path path;
+	std::filesystem::path relative; // to the directory given by the user, or just the file name for files given directly
+};
+
+// Regular files given directly and those found recursively in the given directories, sorted by path. A file reached more than once,
+// e.g. given directly and inside a given directory, is taken once, the first time. Throws std::runtime_error if two different files
+// have the same relative path, since their results would be written to the same file.
+inline std::vector<CorpusFile> collect_files(const std::vector<std::filesystem::path>& paths)
+{
+	std::vector<CorpusFile> files;
+	std::set<std::filesystem::path> seen; // canonical paths
+	auto add = [&](const std::filesystem::path& path, std::filesystem::path relative) {
+		if(seen.insert(std::filesystem::canonical(path)).second)
+			files.push_back({path, std::move(relative)});
+	};
+	for(const auto& path : paths)
+		if(std::filesystem::is_directory(path))
+		{
+			for(const auto& entry : std::filesystem::recursive_directory_iterator(path))
+				if(entry.is_regular_file())
+					add(entry.path(), entry.path().lexically_relative(path));
+		}
+		else if(std::filesystem::exists(path))
+			add(path, path.filename());
+		else
+			throw std::runtime_error("\"" + path.string() + "\" does not exist");
+	std::map<std::filesystem::path, const std::filesystem::path*> path_of; // relative -> path
+	for(const CorpusFile& file : files)
+		if(auto [it, inserted] = path_of.try_emplace(file.relative, &file.path); !inserted)
+			throw std::runtime_error("\"" + it->second->string() + "\" and \"" + file.path.string() + "\" would both be written to \"" + file.relative.string() + "\"");
+	std::ranges::sort(files, {}, &CorpusFile::path);
+	return files;
+}
+
+struct CorpusStats
+{
+	using Duration = std::chrono::steady_clock::duration;
+
+	std::size_t files = 0;
+	std::uintmax_t bytes_read = 0, bytes_written = 0; // of the processed files
+	Duration elapsed{};
+	std::vector<Duration> latencies; // of the processed files, sorted
+	std::vector<std::pair<std::filesystem::path, std::string>> failures; // a file and the reason it failed
+
+	double mb_per_second() const
+	{
+		return bytes_read / 1e6 / std::chrono::duration<double>(elapsed).count();
+	}
+	// the latency which is not exceeded by p percent of the processed files
+	Duration percentile(double p) const
+	{
+		if(latencies.empty())
+			return {};
+		return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p / 100 * latencies.size()))];
+	}
+};
+
+// Applies the cascade on each of the files on threads_cnt threads. The bimachines are shared read-only by all threads and every thread reuses
+// its own buffers, so after the first few files no allocations are made. The result for a file is written to output_dir / file.relative,
+// or dropped if output_dir is empty. A file which fails does not stop the others.
+template<class Bimachine>
+CorpusStats process_corpus(const std::vector<Bimachine>& cascade, const std::vector<CorpusFile>& files, const std::filesystem::path& output_dir, std::size_t threads_cnt = std::thread::hardware_concurrency())
+{
+	struct Worker
+	{
+		Word input, output;
+		std::vector<State> right_path;
+		std::uintmax_t bytes_read = 0, bytes_written = 0;
+	};
+	threads_cnt = std::max<std::size_t>(1, std::min<std::size_t>(threads_cnt, files.size()));
+	std::vector<Worker> workers(threads_cnt);
+	std::vector<std::optional<CorpusStats::Duration>> latency_of(files.size());
+	std::vector<std::string> failure_of(files.size());
+
+	auto start = std::chrono::steady_clock::now();
+	for_each_stealing(files.size(), threads_cnt, [&](std::size_t w, std::size_t i) {
+		Worker& worker = workers[w];
+		try
+		{
+			auto file_start = std::chrono::steady_clock::now();
+			std::ifstream ifs(files[i].path, std::ios::binary);
+			if(!ifs)
+				throw std::runtime_error("could not open the file for reading");
+			worker.input.resize(std::filesystem::file_size(files[i].path));
+			ifs.read(worker.input.data(), worker.input.size());
+			worker.input.resize(ifs.gcount());
+			std::size_t input_size = worker.input.size();
+			for(const auto& bm : cascade)
+			{
+				worker.output.clear();
+				bm(worker.input, worker.output, worker.right_path);
+				std::swap(worker.input, worker.output);
+			}
+			if(!output_dir.empty())
+			{
+				std::filesystem::path out = output_dir / files[i].relative;
+				std::filesystem::create_directories(out.parent_path());
+				std::ofstream ofs(out, std::ios::binary);
+				if(!ofs.write(worker.input.data(), worker.input.size()))
+					throw std::runtime_error("could not write \"" + out.string() + "\"");
+			}
+			worker.bytes_read += input_size;
+			worker.bytes_written += worker.input.size();
+			latency_of[i] = std::chrono::steady_clock::now() - file_start;
+		}
+		catch(const std::exception& e)
+		{
+			failure_of[i] = e.what();
+		}
+	});
+
+	CorpusStats stats;
+	stats.elapsed = std::chrono::steady_clock::now() - start;
+	for(const Worker& worker : workers)
+	{
+		stats.bytes_read += worker.bytes_read;
+		stats.bytes_written += worker.bytes_written;
+	}
+	for(std::size_t i = 0; i < files.size(); i++)
+		if(latency_of[i])
+			stats.latencies.push_back(*latency_of[i]);
+		else
+			stats.failures.emplace_back(files[i].path, std::move(failure_of[i]));
+	stats.files = stats.latencies.size();
+	std::ranges::sort(stats.latencies);
+	return stats;
+}
+
+#endif
@@ -0,0 +1,458 @@
+#ifndef DENSEDFA_HPP
+#define DENSEDFA_HPP
+
+#include <array>
+#include <vector>
+#include <map>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <ranges>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <span>
+#include <string_view>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define DENSEDFA_X86_SIMD
+#endif
+#include "classicalFSA.hpp"
+#include "threadPool.hpp"
+#include "parallelRun.hpp"
+#include "constants.hpp"
+
+// Immutable run-optimized view of a deterministic and total ClassicalFSA whose transitions are sorted (see ClassicalFSA::successor).
+// Each transition costs two loads: one in the 256-entry table mapping a symbol to its column and one in the row-major transition matrix.
+class DenseDFA
+{
+public:
+	static constexpr State SmallStatesCnt = 16;
+	using ColumnMap = std::array<std::uint32_t, std::numeric_limits<USymbol>::max() + 1>;
+private:
+	ColumnMap columnOf; // columnOf[c] == Constants::InvalidColumn <=> c is not in the alphabet
+	std::uint32_t columnsCnt = 0;
+	State statesCnt = 0;
+	State initialState = 0;
+	std::vector<State> table; // table[st * columnsCnt + column] is the successor of st with the symbols in column
+	std::vector<State> syncState; // syncState[column] is the successor of every state with the symbols in column, or Constants::InvalidState
+	// only for automata with at most SmallStatesCnt states: the transitions with column as maps from states to states,
+	// packed into 4-bit fields and as byte vectors for a shuffle instruction
+	std::vector<std::uint64_t> packedNext; // (packedNext[column] >> 4 * st & 0xF) is the successor of st with the symbols in column
+	struct alignas(16) ShuffleMask
+	{
+		std::uint8_t next[16]; // next[st] is the successor of st
+	};
+	std::vector<ShuffleMask> shuffleOf;
+
+	void findSyncStates()
+	{
+		syncState.assign(columnsCnt, Constants::InvalidState);
+		for(std::uint32_t column = 0; column < columnsCnt && statesCnt; column++)
+			if(std::ranges::all_of(std::views::iota(State{1}, statesCnt), [&](State st) { return next(st, column) == next(0, column); }))
+				syncState[column] = next(0, column);
+	}
+	void buildSmallTables()
+	{
+		packedNext.clear();
+		shuffleOf.clear();
+		if(statesCnt > SmallStatesCnt)
+			return;
+		packedNext.assign(columnsCnt, 0);
+		shuffleOf.assign(columnsCnt, {});
+		for(std::uint32_t column = 0; column < columnsCnt; column++)
+			for(State st = 0; st < statesCnt; st++)
+			{
+				packedNext[column] |= static_cast<std::uint64_t>(next(st, column)) << 4 * st;
+				shuffleOf[column].next[st] = static_cast<std::uint8_t>(next(st, column));
+			}
+	}
+	void findPathPacked(const std::ranges::forward_range auto& input, State* path) const
+	{
+		State currSt = *path = initialState;
+		for(Symbol s : input)
+			*++path = currSt = nextSmall(currSt, column(s));
+	}
+#ifdef DENSEDFA_X86_SIMD
+	// every byte of curr is the current state, so shuffling the successors of all states by curr gives the next state in every byte;
+	// the only dependency between consecutive symbols is the shuffle, and the loads depend only on the input
+	template<std::ranges::forward_range Input>
+	[[gnu::target("ssse3")]] void findPathShuffle(const Input& input, State* path) const
+	{
+		__m128i curr = _mm_set1_epi8(static_cast<char>(initialState));
+		*path = initialState;
+		for(Symbol s : input)
+		{
+			curr = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(shuffleOf[column(s)].next)), curr);
+			*++path = static_cast<State>(_mm_cvtsi128_si32(curr) & 0xFF);
+		}
+	}
+#endif
+
+	// one of the runs advanced in lockstep by findPaths; the k-th symbol read is symbol[k * symbolStride] and the state after it is stored in path[k + 1]
+	struct LockstepRun
+	{
+		const Symbol* symbol;
+		std::ptrdiff_t symbolStride;
+		State* path;
+		State state;
+	};
+	// each of the kernels advances all runs by steps symbols
+	void advanceScalar(std::span<LockstepRun> runs, std::size_t steps) const
+	{
+		for(std::size_t k = 0; k < steps; k++)
+			for(LockstepRun& run : runs) // the runs are independent, so their loads overlap
+				run.path[k + 1] = run.state = successor(run.state, run.symbol[static_cast<std::ptrdiff_t>(k) * run.symbolStride]);
+	}
+	[[noreturn]] void throwInvalidSymbols(std::span<const LockstepRun> runs, std::size_t k) const
+	{
+		for(const LockstepRun& run : runs)
+			column(run.symbol[static_cast<std::ptrdiff_t>(k) * run.symbolStride]);
+		throw std::logic_error("no invalid symbol found");
+	}
+#ifdef DENSEDFA_X86_SIMD
+	[[gnu::target("avx2")]] void advanceAvx2(std::span<LockstepRun, 8> runs, std::size_t steps) const
+	{
+		const __m256i columnsCntV = _mm256_set1_epi32(columnsCnt), invalidV = _mm256_set1_epi32(Constants::InvalidColumn);
+		alignas(32) State stored[8];
+		alignas(32) int symbols[8];
+		for(std::size_t lane = 0; lane < 8; lane++)
+			stored[lane] = runs[lane].state;
+		__m256i states = _mm256_load_si256(reinterpret_cast<const __m256i*>(stored));
+		for(std::size_t k = 0; k < steps; k++)
+		{
+			for(std::size_t lane = 0; lane < 8; lane++)
+				symbols[lane] = static_cast<USymbol>(runs[lane].symbol[static_cast<std::ptrdiff_t>(k) * runs[lane].symbolStride]);
+			__m256i columns = _mm256_i32gather_epi32(reinterpret_cast<const int*>(columnOf.data()), _mm256_load_si256(reinterpret_cast<const __m256i*>(symbols)), 4);
+			if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(columns, invalidV)))
+				throwInvalidSymbols(runs, k);
+			states = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table.data()), _mm256_add_epi32(_mm256_mullo_epi32(states, columnsCntV), columns), 4);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(stored), states);
+			for(std::size_t lane = 0; lane < 8; lane++)
+				runs[lane].path[k + 1] = stored[lane];
+		}
+		for(std::size_t lane = 0; lane < 8; lane++)
+			runs[lane].state = stored[lane];
+	}
+	[[gnu::target("avx512f")]] void advanceAvx512(std::span<LockstepRun, 16> runs, std::size_t steps) const
+	{
+		const __m512i columnsCntV = _mm512_set1_epi32(columnsCnt), invalidV = _mm512_set1_epi32(Constants::InvalidColumn), zero = _mm512_setzero_si512();
+		alignas(64) State stored[16];
+		alignas(64) int symbols[16];
+		for(std::size_t lane = 0; lane < 16; lane++)
+			stored[lane] = runs[lane].state;
+		__m512i states = _mm512_load_si512(stored);
+		for(std::size_t k = 0; k < steps; k++)
+		{
+			for(std::size_t lane = 0; lane < 16; lane++)
+				symbols[lane] = static_cast<USymbol>(runs[lane].symbol[static_cast<std::ptrdiff_t>(k) * runs[lane].symbolStride]);
+			// the masked gathers with an explicit source, since the unmasked ones read an uninitialized source in some versions of GCC
+			__m512i columns = _mm512_mask_i32gather_epi32(zero, 0xFFFF, _mm512_load_si512(symbols), columnOf.data(), 4);
+			if(_mm512_cmpeq_epi32_mask(columns, invalidV))
+				throwInvalidSymbols(runs, k);
+			states = _mm512_mask_i32gather_epi32(zero, 0xFFFF, _mm512_add_epi32(_mm512_mullo_epi32(states, columnsCntV), columns), table.data(), 4);
+			_mm512_store_si512(stored, states);
+			for(std::size_t lane = 0; lane < 16; lane++)
+				runs[lane].path[k + 1] = stored[lane];
+		}
+		for(std::size_t lane = 0; lane < 16; lane++)
+			runs[lane].state = stored[lane];
+	}
+#endif
+	// Runs the inputs on Lanes runs in lockstep; a run which finishes its input takes the next one. Between refills all runs are advanced
+	// by advance(runs, steps) for the shortest remaining input. Once fewer inputs than Lanes are left, the remaining runs are advanced by advanceScalar.
+	template<std::size_t Lanes, class Advance>
+	void findPathsLockstep(std::span<const std::string_view> inputs, bool reversed, std::span<std::vector<State>> paths, Advance advance) const
+	{
+		std::array<LockstepRun, Lanes> runs, active;
+		std::array<std::size_t, Lanes> remaining{};
+		std::size_t nextInput = 0, activeCnt = 0;
+		auto refill = [&](std::size_t lane) {
+			for(; nextInput < inputs.size(); nextInput++)
+			{
+				std::string_view input = inputs[nextInput];
+				std::vector<State>& path = paths[nextInput];
+				path.resize(input.size() + 1);
+				path[0] = initialState;
+				if(input.empty())
+					continue;
+				runs[lane] = {reversed ? input.data() + input.size() - 1 : input.data(), reversed ? -1 : 1, path.data(), initialState};
+				remaining[lane] = input.size();
+				activeCnt++;
+				nextInput++;
+				return;
+			}
+		};
+		for(std::size_t lane = 0; lane < Lanes; lane++)
+			refill(lane);
+		while(activeCnt)
+		{
+			std::size_t steps = std::numeric_limits<std::size_t>::max();
+			for(std::size_t lane = 0; lane < Lanes; lane++)
+				if(remaining[lane])
+					steps = std::min(steps, remaining[lane]);
+			if(activeCnt == Lanes)
+				advance(std::span<LockstepRun, Lanes>(runs), steps);
+			else
+			{
+				std::size_t cnt = 0;
+				for(std::size_t lane = 0; lane < Lanes; lane++)
+					if(remaining[lane])
+						active[cnt++] = runs[lane];
+				advanceScalar(std::span<LockstepRun>(active.data(), cnt), steps);
+				for(std::size_t lane = 0, i = 0; lane < Lanes; lane++)
+					if(remaining[lane])
+						runs[lane] = active[i++];
+			}
+			for(std::size_t lane = 0; lane < Lanes; lane++)
+			{
+				if(!remaining[lane])
+					continue;
+				// only unfinished runs are advanced, since the symbol after a reversed input would be before its start
+				if(remaining[lane] -= steps)
+				{
+					runs[lane].symbol += static_cast<std::ptrdiff_t>(steps) * runs[lane].symbolStride;
+					runs[lane].path += steps;
+					continue;
+				}
+				activeCnt--;
+				refill(lane);
+			}
+		}
+	}
+	// depth-first search over the sets of states which contain states of different colors (see lookahead);
+	// depth[set] is the lookahead needed from set, or onStack while set is being visited
+	static constexpr std::size_t onStack = -1;
+	std::optional<std::size_t> lookaheadFrom(const std::vector<State>& set, const std::vector<State>& color, std::map<std::vector<State>, std::size_t>& depth, std::size_t maxSets) const
+	{
+		if(std::ranges::all_of(set, [&](State st) { return color[st] == color[set.front()]; }))
+			return 0;
+		auto [it, inserted] = depth.try_emplace(set, onStack);
+		if(!inserted)
+		{
+			if(it->second == onStack)
+				return std::nullopt;
+			return it->second;
+		}
+		if(depth.size() > maxSets)
+			throw std::length_error("too many sets of states");
+		std::size_t maxDepth = 0;
+		for(std::uint32_t column = 0; column < columnsCnt; column++)
+		{
+			std::vector<State> nextSet;
+			for(State st : set)
+				nextSet.push_back(next(st, column));
+			std::ranges::sort(nextSet);
+			nextSet.erase(std::ranges::unique(nextSet).begin(), nextSet.end());
+			auto nextDepth = lookaheadFrom(nextSet, color, depth, maxSets);
+			if(!nextDepth)
+				return std::nullopt;
+			maxDepth = std::max(maxDepth, *nextDepth);
+		}
+		return it->second = maxDepth + 1;
+	}
+public:
+	DenseDFA() = default;
+	// the columns are the letters of the alphabet, in the order given by alphabetOrder
+	explicit DenseDFA(const ClassicalFSA& dfa)
+	{
+		ColumnMap columns;
+		columns.fill(Constants::InvalidColumn);
+		for(auto [s, ind] : dfa.alphabetOrder)
+			columns[static_cast<USymbol>(s)] = ind;
+		*this = DenseDFA(dfa, columns, dfa.alphabet.size());
+	}
+	// the columns are given by columns, e.g. classes of symbols; symbols in the same column must have the same transitions in dfa
+	DenseDFA(const ClassicalFSA& dfa, const ColumnMap& columns, std::uint32_t columnsCnt):
+		columnOf(columns), columnsCnt(columnsCnt), statesCnt(dfa.statesCnt), initialState(*dfa.initial.begin()),
+		table(static_cast<std::size_t>(statesCnt) * columnsCnt)
+	{
+		for(std::size_t c = 0; c < columnOf.size(); c++)
+			if(columnOf[c] != Constants::InvalidColumn)
+				for(State st = 0; st < statesCnt; st++)
+					table[st * columnsCnt + columnOf[c]] = dfa.successor(st, static_cast<Symbol>(c));
+		findSyncStates();
+		buildSmallTables();
+	}
+	// the transitions are given directly; table[st * columnsCnt + column] is the successor of st with the symbols in column
+	DenseDFA(const ColumnMap& columns, std::uint32_t columnsCnt, State statesCnt, State initialState, std::vector<State> table):
+		columnOf(columns), columnsCnt(columnsCnt), statesCnt(statesCnt), initialState(initialState), table(std::move(table))
+	{
+		if(this->table.size() != static_cast<std::size_t>(statesCnt) * columnsCnt)
+			throw std::invalid_argument("the size of the transition table does not match the numbers of states and columns");
+		findSyncStates();
+		buildSmallTables();
+	}
+
+	State initial() const noexcept { return initialState; }
+	State states() const noexcept { return statesCnt; }
+	std::uint32_t columns() const noexcept { return columnsCnt; }
+	const ColumnMap& columnMap() const noexcept { return columnOf; }
+
+	std::uint32_t column(Symbol s) const
+	{
+		std::uint32_t c = columnOf[static_cast<USymbol>(s)];
+		if(c == Constants::InvalidColumn)
+			throw std::invalid_argument("cannot get successor: '" + std::string{s} + "' is not in the alphabet");
+		return c;
+	}
+	// column must be valid, otherwise the behavior is undefined
+	State next(State from, std::uint32_t column) const noexcept
+	{
+		return table[from * columnsCnt + column];
+	}
+	// at most SmallStatesCnt states; the transitions are also kept in small tables, which findPath and withNext use
+	bool small() const noexcept
+	{
+		return !packedNext.empty();
+	}
+	// same as next, for small automata only
+	State nextSmall(State from, std::uint32_t column) const noexcept
+	{
+		return packedNext[column] >> 4 * from & 0xF;
+	}
+	// Returns f(step), where step(from, column) is the same as next(from, column), but for small automata the successor is extracted
+	// from a 64-bit map which depends only on the column, so consecutive steps are not chained by loads.
+	template<class F>
+	decltype(auto) withNext(F&& f) const
+	{
+		if(small())
+			return std::forward<F>(f)([this](State from, std::uint32_t column) { return nextSmall(from, column); });
+		return std::forward<F>(f)([this](State from, std::uint32_t column) { return next(from, column); });
+	}
+	// the symbols in column are synchronizing iff after reading them the automaton is in the same state regardless of the history
+	State synchronizedState(std::uint32_t column) const noexcept
+	{
+		return syncState[column];
+	}
+	State successor(State from, Symbol with) const
+	{
+		return next(from, column(with));
+	}
+	// path is overwritten; its capacity is reused across calls. Small automata are run by shuffles of their transitions if the CPU supports them.
+	void findPath(const std::ranges::forward_range auto& input, std::vector<State>& path) const
+	{
+		path.resize(std::ranges::distance(input) + 1);
+		if(small())
+		{
+#ifdef DENSEDFA_X86_SIMD
+			if(__builtin_cpu_supports("ssse3"))
+				return findPathShuffle(input, path.data());
+#endif
+			return findPathPacked(input, path.data());
+		}
+		auto pathIt = path.begin();
+		State currSt = *pathIt = initialState;
+		for(Symbol s : input)
+			*++pathIt = currSt = successor(currSt, s);
+	}
+	// The run on input reversed from st which keeps only the states at the ends of blocks: block b is input[blockBegin(b), blockBegin(b + 1)),
+	// where blockBegin(0) == 0 and blockBegin(checkpoints.size()) == input.size(), and checkpoints[b] is the state after reading the input
+	// after block b reversed. Returns the state after reading the whole input reversed.
+	template<class BlockBegin>
+	State findCheckpointsReversed(std::string_view input, State st, std::span<State> checkpoints, BlockBegin blockBegin) const
+	{
+		for(std::size_t b = checkpoints.size(); b-- > 0;)
+		{
+			checkpoints[b] = st;
+			for(std::size_t j = blockBegin(b + 1); j-- > blockBegin(b);)
+				st = successor(st, input[j]);
+		}
+		return st;
+	}
+	// same as findPath, but the input is split into chunks which are run in parallel on pool (see parallel_run); chunksCnt is pool.size() if 0
+	template<std::ranges::random_access_range Input>
+		requires std::ranges::sized_range<Input>
+	void findPath(const Input& input, std::vector<State>& path, ThreadPool& pool, std::size_t chunksCnt = 0) const
+	{
+		const std::size_t n = std::ranges::size(input);
+		auto first = std::ranges::begin(input);
+		path.resize(n + 1);
+		path[0] = initialState;
+		parallel_run(statesCnt, initialState, n,
+			[this, first](State st, std::size_t pos) { return successor(st, first[pos]); },
+			[this, first, &path](std::size_t, std::size_t begin, std::size_t end, State st) {
+				for(std::size_t pos = begin; pos < end; pos++)
+					path[pos + 1] = st = successor(st, first[pos]);
+			}, pool, chunksCnt);
+	}
+	// Same as findPath(input, paths[i]) (with input reversed if reversed) for every inputs[i], but several of the inputs are run in lockstep,
+	// so the independent loads of their transitions overlap instead of each run waiting for its own previous load.
+	// On x86-64 the transitions of all runs are loaded by a single AVX-512 or AVX2 gather if the CPU supports it.
+	void findPaths(std::span<const std::string_view> inputs, bool reversed, std::span<std::vector<State>> paths) const
+	{
+		if(inputs.size() != paths.size())
+			throw std::invalid_argument("the numbers of inputs and paths differ");
+#ifdef DENSEDFA_X86_SIMD
+		if constexpr(sizeof(State) == sizeof(int)) // the gathers use 32-bit indices into the table
+			if(table.size() <= static_cast<std::size_t>(std::numeric_limits<int>::max()))
+			{
+				if(__builtin_cpu_supports("avx512f"))
+					return findPathsLockstep<16>(inputs, reversed, paths, [this](std::span<LockstepRun, 16> runs, std::size_t steps) { advanceAvx512(runs, steps); });
+				if(__builtin_cpu_supports("avx2"))
+					return findPathsLockstep<8>(inputs, reversed, paths, [this](std::span<LockstepRun, 8> runs, std::size_t steps) { advanceAvx2(runs, steps); });
+			}
+#endif
+		findPathsLockstep<8>(inputs, reversed, paths, [this](std::span<LockstepRun, 8> runs, std::size_t steps) { advanceScalar(runs, steps); });
+	}
+	std::vector<State> findPath(const std::ranges::forward_range auto& input) const
+	{
+		std::vector<State> path;
+		findPath(input, path);
+		return path;
+	}
+
+	// Moore's partition refinement of the automaton with transitions table (laid out as in the constructor taking the table): starting from color,
+	// states are split until states of the same color have successors of the same colors. Returns the number of colors.
+	static State refine(std::vector<State>& color, const std::vector<State>& table, std::uint32_t columnsCnt)
+	{
+		for(State colorsCnt = 0; ;)
+		{
+			std::map<std::vector<State>, State> indexOf;
+			std::vector<State> refined;
+			refined.reserve(color.size());
+			for(State st = 0; st < color.size(); st++)
+			{
+				std::vector<State> key{color[st]};
+				for(std::uint32_t column = 0; column < columnsCnt; column++)
+					key.push_back(color[table[st * columnsCnt + column]]);
+				refined.push_back(indexOf.try_emplace(std::move(key), indexOf.size()).first->second);
+			}
+			color = std::move(refined);
+			if(indexOf.size() == colorsCnt)
+				return colorsCnt;
+			colorsCnt = indexOf.size();
+		}
+	}
+	State refine(std::vector<State>& color) const
+	{
+		return refine(color, table, columnsCnt);
+	}
+	// The smallest k such that the color of the state after any input depends only on the last k symbols of the input, or std::nullopt if there is no such k.
+	// The colors are first refined (see refine), since states of the same color may still be split by the symbols read after them, and then
+	// the states after the last k symbols are the images of all reachable states under these symbols; k is bounded iff every cycle in the graph
+	// of these sets goes only through sets of a single color. Throws std::length_error if there are more than maxSets sets.
+	std::optional<std::size_t> lookahead(std::vector<State> color, std::size_t maxSets = 1 << 16) const
+	{
+		if(color.size() != statesCnt)
+			throw std::invalid_argument("the number of colors does not match the number of states");
+		refine(color);
+		std::vector<bool> reachable(statesCnt);
+		std::vector<State> all{initialState};
+		reachable[initialState] = true;
+		for(std::size_t i = 0; i < all.size(); i++)
+			for(std::uint32_t column = 0; column < columnsCnt; column++)
+				if(State st = next(all[i], column); !reachable[st])
+				{
+					reachable[st] = true;
+					all.push_back(st);
+				}
+		std::ranges::sort(all);
+		std::map<std::vector<State>, std::size_t> depth;
+		return lookaheadFrom(all, color, depth, maxSets);
+	}
+};
+
+#endif
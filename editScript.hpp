@@ -0,0 +1,180 @@
+#ifndef EDITSCRIPT_HPP
+#define EDITSCRIPT_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "outputSink.hpp"
+#include "constants.hpp"
+
+// input[offset, offset + length) is replaced by replacement
+struct Edit
+{
+	std::size_t offset;
+	std::size_t length;
+	Word replacement;
+
+	friend bool operator==(const Edit&, const Edit&) = default;
+};
+
+// Edit scripts are sorted by offset and their edits neither overlap nor touch, i.e. every edit starts after the end of the previous one.
+
+// adds to edits the replacement of input[offset, offset + length) by replacement, merging it with the last edit if they touch;
+// offset must not be before the end of the last edit
+inline void add_edit(std::vector<Edit>& edits, std::size_t offset, std::size_t length, std::string_view replacement)
+{
+	if(!edits.empty() && edits.back().offset + edits.back().length == offset)
+	{
+		edits.back().length += length;
+		edits.back().replacement += replacement;
+	}
+	else
+		edits.push_back({offset, length, Word{replacement}});
+}
+
+// the edit which replaces removed, starting at offset, by inserted, without the common prefix and suffix of both
+inline Edit trimmed_edit(std::size_t offset, std::string_view removed, std::string_view inserted)
+{
+	std::size_t common_prefix = 0, common_suffix = 0;
+	while(common_prefix < std::min(removed.size(), inserted.size()) && removed[common_prefix] == inserted[common_prefix])
+		common_prefix++;
+	while(common_prefix + common_suffix < std::min(removed.size(), inserted.size()) &&
+		removed[removed.size() - 1 - common_suffix] == inserted[inserted.size() - 1 - common_suffix])
+		common_suffix++;
+	return {offset + common_prefix, removed.size() - common_prefix - common_suffix,
+		Word{inserted.substr(common_prefix, inserted.size() - common_prefix - common_suffix)}};
+}
+
+// appends to sink input with the edits applied
+template<OutputSink Sink>
+void apply_edits(std::string_view input, const std::vector<Edit>& edits, Sink& sink)
+{
+	std::size_t copied = 0;
+	for(const Edit& edit : edits)
+	{
+		if(edit.offset < copied || edit.offset + edit.length > input.size())
+			throw std::out_of_range("the edits do not fit the input");
+		sink.append(input.substr(copied, edit.offset - copied));
+		sink.append(edit.replacement);
+		copied = edit.offset + edit.length;
+	}
+	sink.append(input.substr(copied));
+}
+
+// Overwrites pieces with the parts of input with the edits applied: the unchanged parts of input and the replacements, in order.
+// Empty pieces are left out. The pieces point into input and edits, so they are valid as long as both are.
+inline void edited_pieces(std::string_view input, const std::vector<Edit>& edits, std::vector<std::string_view>& pieces)
+{
+	pieces.clear();
+	std::size_t copied = 0;
+	for(const Edit& edit : edits)
+	{
+		if(edit.offset < copied || edit.offset + edit.length > input.size())
+			throw std::out_of_range("the edits do not fit the input");
+		if(edit.offset > copied)
+			pieces.push_back(input.substr(copied, edit.offset - copied));
+		if(!edit.replacement.empty())
+			pieces.push_back(edit.replacement);
+		copied = edit.offset + edit.length;
+	}
+	if(copied < input.size())
+		pieces.push_back(input.substr(copied));
+}
+
+// The edits which give the same result as applying first and then second on the result.
+// Both scripts are read as sequences of operations which keep, delete or insert symbols; the operations of second consume the output of first,
+// so the ones of first which delete and the ones of second which insert are passed on, and the others are matched against each other.
+inline std::vector<Edit> compose_edits(const std::vector<Edit>& first, const std::vector<Edit>& second)
+{
+	enum class Kind { Keep, Delete, Insert };
+	// the current operation of a script; after its last edit it keeps the rest of the input forever
+	struct Cursor
+	{
+		const std::vector<Edit>& edits;
+		std::size_t next_edit = 0, position = 0; // in the input of the script
+		Kind kind = Kind::Keep;
+		std::size_t left = 0; // of the current operation
+		std::string_view inserted; // the rest of the inserted text if kind == Kind::Insert
+
+		explicit Cursor(const std::vector<Edit>& edits): edits(edits) { advance(); }
+		// moves to the next operation of nonzero length
+		void advance()
+		{
+			while(!left)
+			{
+				if(next_edit == edits.size())
+				{
+					kind = Kind::Keep;
+					left = std::numeric_limits<std::size_t>::max();
+				}
+				else if(const Edit& edit = edits[next_edit]; kind == Kind::Keep && position < edit.offset)
+					left = edit.offset - position;
+				else if(kind == Kind::Keep && edit.length)
+				{
+					kind = Kind::Delete;
+					left = edit.length;
+				}
+				else if(kind != Kind::Insert && !edit.replacement.empty())
+				{
+					kind = Kind::Insert;
+					inserted = edit.replacement;
+					left = inserted.size();
+				}
+				else
+				{
+					kind = Kind::Keep;
+					next_edit++;
+				}
+			}
+		}
+		bool at_end() const noexcept
+		{
+			return next_edit == edits.size();
+		}
+		void consume(std::size_t n)
+		{
+			if(kind != Kind::Insert)
+				position += n;
+			else
+				inserted.remove_prefix(n);
+			if(left != std::numeric_limits<std::size_t>::max())
+			{
+				left -= n;
+				advance();
+			}
+		}
+	};
+	std::vector<Edit> composed;
+	Cursor a(first), b(second);
+	while(!a.at_end() || !b.at_end())
+	{
+		if(a.kind == Kind::Delete)
+		{
+			add_edit(composed, a.position, a.left, {});
+			a.consume(a.left);
+		}
+		else if(b.kind == Kind::Insert)
+		{
+			add_edit(composed, a.position, 0, b.inserted);
+			b.consume(b.left);
+		}
+		else
+		{
+			std::size_t n = std::min(a.left, b.left);
+			if(a.kind == Kind::Keep && b.kind == Kind::Delete)
+				add_edit(composed, a.position, n, {});
+			else if(a.kind == Kind::Insert && b.kind == Kind::Keep)
+				add_edit(composed, a.position, 0, a.inserted.substr(0, n));
+			// kept by both or inserted by first and deleted by second: nothing to add
+			a.consume(n);
+			b.consume(n);
+		}
+	}
+	return composed;
+}
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef INCREMENTALBIMACHINE_HPP
+#define INCREMENTALBIMACHINE_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include "compiledBimachine.hpp"
+#include "editScript.hpp"
+#include "constants.hpp"
+
+// Keeps a text together with the output of a bimachine for it, cut into blocks of about block_size symbols. Besides the text and the output,
+// only the states of both automata at the ends of every block are stored. After a part of the text is replaced, the right states at the ends
+// of the blocks are recomputed backwards from the end of the replacement until one is the stored one, the left states forwards until one
+// is the stored one, and only the output of the blocks between them is recomputed. So a replacement costs time proportional to its length
+// and the distances to these blocks, plus a pass over the sizes of the blocks before it. The bimachine is not copied, so it must outlive
+// the IncrementalBimachine.
+class IncrementalBimachine
+{
+	struct Block
+	{
+		Word text, output; // output is the output for the positions of text
+		State left_st; // before text
+		State right_st; // used at the last position of text, i.e. after reading what follows text reversed
+	};
+	const CompiledBimachineWithFinalOutput& bm;
+	std::size_t block_size;
+	std::vector<Block> blocks; // none of them is empty
+	std::size_t text_size = 0;
+	State end_left_st; // after the text
+	Word final_output;
+	std::vector<State> right_path; // scratch space
+
+	// Appends text to rebuilt as blocks of about block_size symbols, when the left automaton is in curr_left_st before text
+	// and the right automaton is in curr_right_st after reading what follows text reversed. Returns the state of the left automaton after text.
+	State rebuild(std::string_view text, State curr_left_st, State curr_right_st, std::vector<Block>& rebuilt)
+	{
+		const std::size_t cnt = std::max<std::size_t>(1, (text.size() + block_size / 2) / block_size);
+		std::vector<State> right_at_end(cnt); // of every new block
+		bm.right_checkpoints(text, curr_right_st, right_at_end, [&](std::size_t i) { return text.size() * i / cnt; });
+		for(std::size_t i = 0; i < cnt; i++)
+		{
+			std::size_t begin = text.size() * i / cnt, end = text.size() * (i + 1) / cnt;
+			if(begin == end)
+				continue;
+			Block& block = rebuilt.emplace_back(Word{text.substr(begin, end - begin)}, Word{}, curr_left_st, right_at_end[i]);
+			block.output.reserve(block.text.size());
+			curr_left_st = bm.apply_between(block.text, curr_left_st, block.right_st, block.output, right_path);
+		}
+		return curr_left_st;
+	}
+public:
+	IncrementalBimachine(const CompiledBimachineWithFinalOutput& bm, std::string_view text, std::size_t block_size = 1 << 12): bm(bm), block_size(block_size), text_size(text.size())
+	{
+		if(!block_size)
+			throw std::invalid_argument("the block size must be positive");
+		end_left_st = rebuild(text, bm.left_initial(), bm.right_initial(), blocks);
+		bm.final_output(end_left_st, final_output);
+	}
+
+	// Replaces text[pos, pos + length) with replacement and updates the output. Returns the change of the output as an edit of the previous output,
+	// which can be passed to the IncrementalBimachine of the next stage of a cascade (see IncrementalCascade).
+	// Throws std::invalid_argument and changes nothing if replacement has a symbol outside the alphabet.
+	Edit replace(std::size_t pos, std::size_t length, std::string_view replacement)
+	{
+		if(pos > text_size || length > text_size - pos)
+			throw std::out_of_range("the replaced part is not in the text");
+		for(Symbol s : replacement)
+			bm.right_successor(bm.right_initial(), s);
+
+		// the blocks [first, last) contain the replaced part; an insertion at the end of the text goes into the last block
+		std::size_t first = 0, first_begin = 0;
+		while(first + 1 < blocks.size() && first_begin + blocks[first].text.size() <= pos)
+			first_begin += blocks[first++].text.size();
+		std::size_t last = first, last_end = first_begin;
+		while(last < blocks.size() && (last == first || last_end < pos + length))
+			last_end += blocks[last++].text.size();
+		// a short result is merged with a neighbouring block, so that the blocks do not become ever smaller
+		if(last_end - first_begin - length + replacement.size() < block_size / 2)
+		{
+			if(last < blocks.size())
+				last_end += blocks[last++].text.size();
+			else if(first > 0)
+				first_begin -= blocks[--first].text.size();
+		}
+		const std::size_t replaced_first = first;
+		Word region;
+		region.reserve(last_end - first_begin - length + replacement.size());
+		for(std::size_t b = first; b < last; b++)
+			region += blocks[b].text;
+		region.replace(pos - first_begin, length, replacement);
+
+		// the right states after the region do not change; the blocks before it are added until the right state at the end of one is the stored one
+		const State right_after = first < last ? blocks[last - 1].right_st : bm.right_initial();
+		State curr_right_st = right_after;
+		for(std::size_t j = region.size(); j-- > 0;)
+			curr_right_st = bm.right_successor(curr_right_st, region[j]);
+		while(first > 0 && curr_right_st != blocks[first - 1].right_st)
+		{
+			const Word& text = blocks[--first].text;
+			for(std::size_t j = text.size(); j-- > 0;)
+				curr_right_st = bm.right_successor(curr_right_st, text[j]);
+		}
+		if(first < replaced_first)
+		{
+			Word prefix;
+			for(std::size_t b = first; b < replaced_first; b++)
+				prefix += blocks[b].text;
+			region.insert(0, prefix);
+		}
+
+		// the region is cut into new blocks; the blocks after it are recomputed until the left state before one is the stored one
+		std::vector<Block> rebuilt;
+		State curr_left_st = rebuild(region, first < blocks.size() ? blocks[first].left_st : bm.left_initial(), right_after, rebuilt);
+		while(last < blocks.size() && curr_left_st != blocks[last].left_st)
+		{
+			Block& block = rebuilt.emplace_back(blocks[last].text, Word{}, curr_left_st, blocks[last].right_st);
+			curr_left_st = bm.apply_between(block.text, curr_left_st, block.right_st, block.output, right_path);
+			last++;
+		}
+		const bool final_changed = last == blocks.size() && curr_left_st != end_left_st;
+
+		// the output of the blocks [first, last), and the final output if it changed, is replaced by the output of the rebuilt blocks
+		std::size_t out_from = 0;
+		for(std::size_t b = 0; b < first; b++)
+			out_from += blocks[b].output.size();
+		Word old_region, new_region;
+		for(std::size_t b = first; b < last; b++)
+			old_region += blocks[b].output;
+		for(const Block& block : rebuilt)
+			new_region += block.output;
+		if(final_changed)
+		{
+			old_region += final_output;
+			final_output.clear();
+			bm.final_output(curr_left_st, final_output);
+			new_region += final_output;
+		}
+		Edit change = trimmed_edit(out_from, old_region, new_region);
+
+		if(last == blocks.size())
+			end_left_st = curr_left_st;
+		auto it = blocks.erase(blocks.begin() + first, blocks.begin() + last);
+		blocks.insert(it, std::make_move_iterator(rebuilt.begin()), std::make_move_iterator(rebuilt.end()));
+		text_size = text_size - length + replacement.size();
+		return change;
+	}
+
+	Word Text() const
+	{
+		Word text;
+		text.reserve(text_size);
+		for(const Block& block : blocks)
+			text += block.text;
+		return text;
+	}
+	Word Output() const
+	{
+		Word output;
+		for(const Block& block : blocks)
+			output += block.output;
+		return output += final_output;
+	}
+	std::size_t TextSize() const noexcept { return text_size; }
+};
+
+// A cascade of IncrementalBimachine; the change of the output of every stage is passed on as the replacement for the next one.
+class IncrementalCascade
+{
+	Word text; // only used if there are no stages; otherwise the text is kept by the first stage
+	std::vector<IncrementalBimachine> stages;
+public:
+	IncrementalCascade(const std::vector<CompiledBimachineWithFinalOutput>& bms, Word text, std::size_t block_size = 1 << 12): text(std::move(text))
+	{
+		stages.reserve(bms.size());
+		for(const auto& bm : bms)
+			stages.emplace_back(bm, stages.empty() ? Word{std::move(this->text)} : stages.back().Output(), block_size);
+	}
+
+	// replaces text[pos, pos + length) with replacement and updates the outputs of all stages; returns the change of the final output
+	Edit replace(std::size_t pos, std::size_t length, std::string_view replacement)
+	{
+		if(stages.empty())
+		{
+			if(pos > text.size() || length > text.size() - pos)
+				throw std::out_of_range("the replaced part is not in the text");
+			Edit change = trimmed_edit(pos, std::string_view(text).substr(pos, length), replacement);
+			text.replace(pos, length, replacement);
+			return change;
+		}
+		Edit change{pos, length, Word{replacement}};
+		for(auto& stage : stages)
+			change = stage.replace(change.offset, change.length, change.replacement);
+		return change;
+	}
+
+	Word Text() const { return stages.empty() ? text : stages.front().Text(); }
+	Word Output() const { return stages.empty() ? text : stages.back().Output(); }
+};
+
+#endif
@@ -4,12 +4,24 @@
 #include <string>
 #include <filesystem>
 #include <chrono>
+#include <thread>
+#include <string_view>
+#include <vector>
+#include <optional>
 #include "regularExpression.hpp"
 #include "ThompsonsConstruction.hpp"
 #include "transducer.hpp"
 #include "contextualReplacementRule.hpp"
 #include "twostepBimachine.hpp"
 #include "classicalBimachine.hpp"
+#include "compiledBimachine.hpp"
+#include "compiledTwostepBimachine.hpp"
+#include "corpusDriver.hpp"
+#include "cascadePipeline.hpp"
+#include "bimachineCascade.hpp"
+#include "boundedDelayStream.hpp"
+#include "sequentialTransducer.hpp"
+#include "tokenCache.hpp"
 #include "PorterStemmer.hpp"
 
 std::string readFromFile(const std::filesystem::path& path, char delim = '\n')
@@ -23,12 +35,94 @@ std::string readFromFile(const std::filesystem::path& path, char delim = '\n')
 }
 
 // g++ -Wall -pedantic-errors -O3 -std=c++23 -fdiagnostics-color=always *.cpp
+// usage: main < input > output
+//        main [-j threads] -p < input > output    the steps run concurrently as a pipeline over chunks of the input; the threads are shared among the steps by their cost
+//        main -s < input > output    single pass with bounded delay; the output is written while the input is read
+//        main -t < input > output    single pass of sequential transducers determinized from the steps
+//        main -c < input > output    the output of every word is computed once and then taken from a cache
+//        main -e < input > output    only the changed spans are found; the output is rebuilt from them
+//        main -i < input > output    the steps which never lengthen what was read so far rewrite the input in place
+//        main -m < input > counts    prints how many times every rule of every step is applied instead of the output
+//        main -n ...                 uppercase letters are lowercased and digits and punctuation become spaces, within the first step; combines with the other modes but -m
+//        main -u ...                 the symbols outside the alphabet are not rejected but read as spaces and output unchanged; combines with the other modes
+//        main [-o output_dir] [-j threads] file_or_dir...    stems every file, writing the results under output_dir if given
 
 int main(int argc, char** argv) try
 {
 	using Resolution = std::chrono::milliseconds;
-	std::vector<BimachineWithFinalOutput> bm;
-	//std::vector<TwostepBimachine> bm;
+	std::filesystem::path output_dir;
+	std::size_t threads_cnt = std::thread::hardware_concurrency();
+	std::vector<std::filesystem::path> paths;
+	std::optional<Symbol> others_like;
+	bool pipeline = false, stream = false, sequential = false, cached = false, edit_script = false, in_place = false, matches = false, normalize = false;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if((arg == "-o" || arg == "-j") && i + 1 == argc)
+			throw std::invalid_argument("missing value of " + std::string{arg});
+		if(arg == "-o")
+			output_dir = argv[++i];
+		else if(arg == "-j")
+			threads_cnt = std::stoul(argv[++i]);
+		else if(arg == "-p")
+			pipeline = true;
+		else if(arg == "-s")
+			stream = true;
+		else if(arg == "-t")
+			sequential = true;
+		else if(arg == "-c")
+			cached = true;
+		else if(arg == "-e")
+			edit_script = true;
+		else if(arg == "-i")
+			in_place = true;
+		else if(arg == "-m")
+			matches = true;
+		else if(arg == "-u")
+			others_like = ' ';
+		else if(arg == "-n")
+			normalize = true;
+		else
+			paths.emplace_back(arg);
+	}
+	if(matches)
+	{
+		if(normalize)
+			throw std::invalid_argument("-n cannot be combined with -m");
+		// the rules are counted on the input of every step, so every step but the last one still builds its output for the next one
+		std::vector<CompiledTwostepBimachine> steps;
+		for(std::size_t i = 0; i < PorterStemmer::steps_cnt; i++)
+		{
+			std::vector<ContextualReplacementRuleRepresentation> batch;
+			for(const auto& rule : PorterStemmer::steps[i])
+				batch.emplace_back(rule, PorterStemmer::alphabet);
+			steps.emplace_back(std::move(batch), others_like);
+		}
+		Word input, next;
+		std::getline(std::cin, input, '\0');
+		std::vector<State> right_path;
+		std::vector<std::size_t> counts;
+		auto start = std::chrono::steady_clock::now();
+		for(std::size_t i = 0; i < steps.size(); i++)
+		{
+			counts.assign(steps[i].RulesCnt(), 0);
+			steps[i].count_matches(input, counts, right_path);
+			for(std::size_t rule = 0; rule < counts.size(); rule++)
+				std::cout << "step " << i << ", rule " << rule << ": " << counts[rule] << "\n";
+			if(i + 1 < steps.size())
+			{
+				next.clear();
+				steps[i](input, next, right_path);
+				std::swap(input, next);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for counting: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+		return 0;
+	}
+
+	BimachineCascade<CompiledBimachineWithFinalOutput> bm;
+	//BimachineCascade<CompiledTwostepBimachine> bm;
 	std::vector<ContextualReplacementRuleRepresentation> batch;
 	{
 		auto start = std::chrono::steady_clock::now();
@@ -39,7 +133,7 @@ int main(int argc, char** argv) try
 				batch.emplace_back(PorterStemmer::steps[i][j], PorterStemmer::alphabet);
 			auto end_rep = std::chrono::steady_clock::now();
 			std::cerr << "\telapsed time for creating FSR at step " << i << ": " << std::chrono::duration_cast<Resolution>(end_rep - start) << "\n";
-			bm.emplace_back(std::move(batch));
+			bm.emplace_stage(std::move(batch), others_like);
 			batch.clear();
 			auto end = std::chrono::steady_clock::now();
 			std::cerr << "\telapsed time for constructing the bimachine only at step " << i << ": " << std::chrono::duration_cast<Resolution>(end - end_rep) << "\n";
@@ -48,6 +142,113 @@ int main(int argc, char** argv) try
 		auto end = std::chrono::steady_clock::now();
 		std::cerr << "elapsed time for construction: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
 	}
+	if(normalize)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for(const auto& rule : PorterStemmer::normalization)
+			batch.emplace_back(rule, PorterStemmer::normalization_alphabet);
+		bm.prepend(CompiledBimachineWithFinalOutput{std::move(batch), others_like});
+		batch.clear();
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for prepending the normalization to the first step: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+	}
+	{
+		auto start = std::chrono::steady_clock::now();
+		bm.compose_stages();
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for composing the steps into " << bm.size() << " bimachine(s): " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+	}
+	if(!paths.empty())
+	{
+		std::vector<CorpusFile> files = collect_files(paths);
+		CorpusStats stats = process_corpus(bm.Stages(), files, output_dir, threads_cnt);
+		for(const auto& [path, reason] : stats.failures)
+			std::cerr << "failed to process \"" << path.string() << "\": " << reason << "\n";
+		std::cerr << "processed " << stats.files << " of " << files.size() << " files, " << stats.bytes_read << " bytes in "
+			<< std::chrono::duration_cast<Resolution>(stats.elapsed) << " (" << stats.mb_per_second() << " MB/s)\n";
+		std::cerr << "latency per file: p50 " << std::chrono::duration_cast<std::chrono::microseconds>(stats.percentile(50))
+			<< ", p90 " << std::chrono::duration_cast<std::chrono::microseconds>(stats.percentile(90))
+			<< ", p99 " << std::chrono::duration_cast<std::chrono::microseconds>(stats.percentile(99))
+			<< ", max " << std::chrono::duration_cast<std::chrono::microseconds>(stats.percentile(100)) << "\n";
+		return stats.failures.empty() ? 0 : 1;
+	}
+
+	if(pipeline)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run_pipeline(bm.Stages(), std::cin, std::cout, {.threads_cnt = threads_cnt});
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for reading, replacing and printing: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+		return 0;
+	}
+
+	if(sequential)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::vector<SequentialTransducer> transducers;
+		for(std::size_t i = 0; i < bm.size(); i++)
+		{
+			auto transducer = SequentialTransducer::determinize(bm[i]);
+			if(!transducer)
+				throw std::runtime_error("step " + std::to_string(i) + " is not subsequential");
+			std::cerr << "\tstates of the sequential transducer at step " << i << ": " << transducer->StatesCnt() << "\n";
+			transducers.push_back(std::move(*transducer));
+		}
+		auto end_construction = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for determinization: " << std::chrono::duration_cast<Resolution>(end_construction - start) << "\n";
+		std::vector<State> states;
+		for(const auto& transducer : transducers)
+			states.push_back(transducer.initial());
+		Word piece(1 << 16, '\0'), buffers[2];
+		for(bool last = false; !last;)
+		{
+			std::cin.read(piece.data(), piece.size());
+			last = !std::cin;
+			std::string_view curr{piece.data(), static_cast<std::size_t>(std::cin.gcount())};
+			for(std::size_t i = 0; i < transducers.size(); i++)
+			{
+				Word& next = buffers[i % 2];
+				next.clear();
+				for(Symbol s : curr)
+					states[i] = transducers[i].step(states[i], s, next);
+				if(last)
+					transducers[i].finish(states[i], next);
+				curr = next;
+			}
+			std::cout << curr;
+		}
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for reading, replacing and printing: " << std::chrono::duration_cast<Resolution>(end - end_construction) << "\n";
+		return 0;
+	}
+	if(stream)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::vector<BoundedDelayStream> streams(bm.Stages().begin(), bm.Stages().end());
+		for(std::size_t i = 0; i < streams.size(); i++)
+			std::cerr << "\tlookahead at step " << i << ": " << streams[i].Lookahead() << "\n";
+		Word piece(1 << 16, '\0'), buffers[2];
+		for(bool last = false; !last;)
+		{
+			std::cin.read(piece.data(), piece.size());
+			last = !std::cin;
+			std::string_view curr{piece.data(), static_cast<std::size_t>(std::cin.gcount())};
+			for(std::size_t i = 0; i < streams.size(); i++)
+			{
+				Word& next = buffers[i % 2];
+				next.clear();
+				streams[i].feed(curr, next);
+				if(last)
+					streams[i].finish(next);
+				curr = next;
+			}
+			std::cout << curr;
+		}
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for reading, replacing and printing: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+		return 0;
+	}
+
 	Word input;
 	{
 		auto start = std::chrono::steady_clock::now();
@@ -55,21 +256,51 @@ int main(int argc, char** argv) try
 		auto end = std::chrono::steady_clock::now();
 		std::cerr << "elapsed time for reading: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
 	}
+	Word output;
+	if(cached)
 	{
 		auto start = std::chrono::steady_clock::now();
-		for(std::size_t i = 0; i < PorterStemmer::steps_cnt; i++)
-		{
-			auto start = std::chrono::steady_clock::now();
-			input = bm[i](input);
-			auto end = std::chrono::steady_clock::now();
-			std::cerr << "\telapsed time for replacing at step " << i << ": " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
-		}
+		TokenwiseCascade tokenwise(bm.Stages(), " \r\n\t\v");
+		output.reserve(input.size());
+		tokenwise(input, output);
+		auto end = std::chrono::steady_clock::now();
+		const TokenCache& cache = tokenwise.Cache();
+		std::cerr << "\tcached words: " << cache.size() << ", hits: " << cache.hits() << ", misses: " << cache.misses() << " (hit rate " << cache.hit_rate() << ")\n";
+		std::cerr << "elapsed time for replacing: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+	}
+	else if(edit_script)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::vector<Edit> edits = bm.find_edits(input);
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "\tchanged spans: " << edits.size() << "\n";
+		std::cerr << "elapsed time for finding the changes: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+		output.reserve(input.size());
+		apply_edits(input, edits, output);
+	}
+	else if(in_place)
+	{
+		for(std::size_t i = 0; i < bm.size(); i++)
+			std::cerr << "\tstep " << i << (bm[i].InPlace() ? " is" : " is not") << " applied in place\n";
+		auto start = std::chrono::steady_clock::now();
+		bm.apply_in_place(input);
+		output = std::move(input);
+		auto end = std::chrono::steady_clock::now();
+		std::cerr << "elapsed time for replacing: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
+	}
+	else
+	{
+		auto start = std::chrono::steady_clock::now();
+		output.reserve(input.size());
+		bm.apply_tiled(input, output);
 		auto end = std::chrono::steady_clock::now();
+		for(std::size_t i = 0; i < bm.size(); i++)
+			std::cerr << "\telapsed time for replacing at step " << i << ": " << std::chrono::duration_cast<Resolution>(bm.timings()[i]) << "\n";
 		std::cerr << "elapsed time for replacing: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
 	}
 	{
 		auto start = std::chrono::steady_clock::now();
-		std::cout << input;
+		std::cout << output;
 		auto end = std::chrono::steady_clock::now();
 		std::cerr << "elapsed time for printing: " << std::chrono::duration_cast<Resolution>(end - start) << "\n";
 	}
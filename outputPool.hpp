@@ -0,0 +1,45 @@
+#ifndef OUTPUTPOOL_HPP
+#define OUTPUTPOOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include "constants.hpp"
+
+// stores distinct output words contiguously; each word is referred to by its id
+class OutputPool
+{
+	std::string buffer;
+	std::vector<std::uint32_t> begin{0}; // the word with id i is buffer[begin[i], begin[i + 1])
+	std::map<Word, std::uint32_t, std::less<>> ids;
+public:
+	static constexpr std::uint32_t Identity = -1; // sentinel for "the output is the input symbol itself"
+
+	std::uint32_t intern(std::string_view w)
+	{
+		if(auto it = ids.find(w); it != ids.end())
+			return it->second;
+		std::uint32_t id = size();
+		buffer.append(w);
+		begin.push_back(buffer.size());
+		ids.emplace(w, id);
+		return id;
+	}
+	std::string_view operator[](std::uint32_t id) const noexcept
+	{
+		return {buffer.data() + begin[id], buffer.data() + begin[id + 1]};
+	}
+	std::uint32_t size() const noexcept
+	{
+		return begin.size() - 1;
+	}
+	std::size_t bytes() const noexcept
+	{
+		return buffer.size();
+	}
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef OUTPUTSINK_HPP
+#define OUTPUTSINK_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include "constants.hpp"
+
+// A destination for the output of a bimachine. Word (or any std::string) is a growable sink; it is only appended to,
+// so a caller can clear and reuse it across calls without reallocating.
+template<class Sink>
+concept OutputSink = requires(Sink& sink, Symbol s, std::string_view w)
+{
+	sink.push_back(s);
+	sink.append(w);
+};
+
+// Writes into a caller-provided buffer of fixed size. Output which does not fit is dropped but still counted,
+// so after an overflow size() is the size of the buffer needed for the whole output.
+// The appended words may overlap the buffer, which allows rewriting a buffer in place.
+class SpanSink
+{
+	std::span<Symbol> buffer;
+	std::size_t written = 0;
+public:
+	explicit SpanSink(std::span<Symbol> buffer) noexcept: buffer(buffer) {}
+
+	void push_back(Symbol s) noexcept
+	{
+		if(written < buffer.size())
+			buffer[written] = s;
+		written++;
+	}
+	void append(std::string_view w) noexcept
+	{
+		if(written < buffer.size())
+		{
+			std::string_view fits = w.substr(0, buffer.size() - written);
+			std::char_traits<Symbol>::move(buffer.data() + written, fits.data(), fits.size());
+		}
+		written += w.size();
+	}
+	void clear() noexcept { written = 0; }
+	bool overflow() const noexcept { return written > buffer.size(); }
+	std::size_t size() const noexcept { return written; }
+	std::string_view view() const noexcept { return {buffer.data(), std::min(written, buffer.size())}; }
+};
+
+template<std::output_iterator<Symbol> OutputIt>
+class IteratorSink
+{
+	OutputIt it;
+public:
+	explicit IteratorSink(OutputIt it): it(std::move(it)) {}
+
+	void push_back(Symbol s)
+	{
+		*it++ = s;
+	}
+	void append(std::string_view w)
+	{
+		it = std::ranges::copy(w, std::move(it)).out;
+	}
+	OutputIt base() const { return it; }
+};
+
+// Drops the output and only counts its length.
+class CountingSink
+{
+	std::size_t written = 0;
+public:
+	void push_back(Symbol) noexcept
+	{
+		written++;
+	}
+	void append(std::string_view w) noexcept
+	{
+		written += w.size();
+	}
+	std::size_t size() const noexcept { return written; }
+};
+
+class StreamSink
+{
+	std::ostream& os;
+public:
+	explicit StreamSink(std::ostream& os) noexcept: os(os) {}
+
+	void push_back(Symbol s)
+	{
+		os.put(s);
+	}
+	void append(std::string_view w)
+	{
+		os.write(w.data(), w.size());
+	}
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef PARALLELRUN_HPP
+#define PARALLELRUN_HPP
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <future>
+#include <concepts>
+#include "threadPool.hpp"
+#include "constants.hpp"
+
+// Enumerative parallel execution of a deterministic automaton with states 0, 1, ..., states_cnt - 1 over positions 0, 1, ..., n - 1.
+// The positions are split into chunks. Every chunk except the first is run from all states at once; runs which meet are merged,
+// so after a few symbols usually a single run is left. The maps from start to end states are then composed over the chunks,
+// which gives the actual start state of every chunk, and finally each chunk is processed from its actual start state.
+// Only the last phase produces results, so when the runs of every chunk merge after a few symbols, the work is about twice the work
+// of a sequential run. In the worst case, when the runs never meet, every chunk but the first is run from all states_cnt states,
+// and the work is about states_cnt + 1 times the work of a sequential run.
+
+// the first position of the i-th of chunks_cnt chunks of n positions
+inline std::size_t chunk_begin(std::size_t n, std::size_t chunks_cnt, std::size_t i) noexcept
+{
+	return n * i / chunks_cnt;
+}
+
+// the number of chunks actually used for n positions when chunks_cnt are requested; 0 requests one chunk per thread of pool
+inline std::size_t chunks_cnt_for(std::size_t n, std::size_t chunks_cnt, const ThreadPool& pool) noexcept
+{
+	return std::max<std::size_t>(1, std::min(chunks_cnt ? chunks_cnt : pool.size(), n));
+}
+
+// waits for all futures before getting any of them, so no task is left running if one of them throws; the futures are of tasks
+// submitted to pool, which runs queued tasks while waiting (see ThreadPool::wait), so this may also be called from a task of pool
+template<class T>
+std::vector<T> wait_all(std::vector<std::future<T>>& futures, ThreadPool& pool)
+{
+	for(auto& f : futures)
+		pool.wait(f);
+	std::vector<T> results;
+	results.reserve(futures.size());
+	for(auto& f : futures)
+		results.push_back(f.get());
+	return results;
+}
+inline void wait_all(std::vector<std::future<void>>& futures, ThreadPool& pool)
+{
+	for(auto& f : futures)
+		pool.wait(f);
+	for(auto& f : futures)
+		f.get();
+}
+
+// end_of[st] is the state reached after processing the positions [begin, end) from st; next(st, pos) is the state after processing pos from st
+template<class Next>
+	requires std::is_invocable_r_v<State, Next&, State, std::size_t>
+std::vector<State> run_from_all(State states_cnt, std::size_t begin, std::size_t end, Next& next)
+{
+	std::vector<State> active(states_cnt), run_of(states_cnt); // the distinct states of the runs and the run which each start state belongs to
+	for(State st = 0; st < states_cnt; st++)
+		active[st] = run_of[st] = st;
+	std::vector<State> merged_into(states_cnt, Constants::InvalidState);
+	std::vector<State> new_index(states_cnt);
+	for(std::size_t pos = begin; pos < end; pos++)
+	{
+		if(active.size() == 1)
+		{
+			for(; pos < end; pos++)
+				active[0] = next(active[0], pos);
+			break;
+		}
+		std::size_t distinct = 0;
+		for(std::size_t i = 0; i < active.size(); i++)
+		{
+			State st = next(active[i], pos);
+			if(merged_into[st] == Constants::InvalidState)
+			{
+				merged_into[st] = distinct;
+				active[distinct++] = st;
+			}
+			new_index[i] = merged_into[st];
+		}
+		if(distinct < active.size())
+			for(State& run : run_of)
+				run = new_index[run];
+		for(std::size_t i = 0; i < distinct; i++)
+			merged_into[active[i]] = Constants::InvalidState;
+		active.resize(distinct);
+	}
+	for(State& run : run_of)
+		run = active[run];
+	return run_of;
+}
+
+// Calls process(i, begin, end, start) in parallel for the consecutive chunks [begin, end) covering the positions 0, 1, ..., n - 1,
+// where i is the index of the chunk and start is the state before begin of the sequential run from initial.
+// There are chunks_cnt_for(n, chunks_cnt, pool) chunks.
+// next and process are called concurrently from several threads. This may be called from a task of pool.
+template<class Next, class Process>
+	requires std::is_invocable_r_v<State, Next&, State, std::size_t> && std::invocable<Process&, std::size_t, std::size_t, std::size_t, State>
+void parallel_run(State states_cnt, State initial, std::size_t n, Next next, Process process, ThreadPool& pool, std::size_t chunks_cnt = 0)
+{
+	chunks_cnt = chunks_cnt_for(n, chunks_cnt, pool);
+	if(chunks_cnt == 1)
+	{
+		process(0, 0, n, initial);
+		return;
+	}
+	// the first chunk is run only from initial, the others from all states
+	std::vector<std::future<std::vector<State>>> maps;
+	maps.push_back(pool.submit([&] {
+		State st = initial;
+		for(std::size_t pos = 0; pos < chunk_begin(n, chunks_cnt, 1); pos++)
+			st = next(st, pos);
+		return std::vector<State>(states_cnt, st);
+	}));
+	for(std::size_t i = 1; i + 1 < chunks_cnt; i++)
+		maps.push_back(pool.submit([&, i] { return run_from_all(states_cnt, chunk_begin(n, chunks_cnt, i), chunk_begin(n, chunks_cnt, i + 1), next); }));
+	std::vector<std::vector<State>> end_of = wait_all(maps, pool);
+
+	// the number of chunks is small, so the maps are composed sequentially
+	std::vector<std::future<void>> chunks;
+	State start = initial;
+	for(std::size_t i = 0; i < chunks_cnt; i++)
+	{
+		chunks.push_back(pool.submit([&, i, start] { process(i, chunk_begin(n, chunks_cnt, i), chunk_begin(n, chunks_cnt, i + 1), start); }));
+		if(i < end_of.size())
+			start = end_of[i][start];
+	}
+	wait_all(chunks, pool);
+}
+
+#endif
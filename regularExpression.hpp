@@ -11,6 +11,7 @@
 #include <algorithm>
 #include "constants.hpp"
 #include "utilities.hpp"
+#include "utf8.hpp"
 
 #define NDEBUG
 
@@ -22,6 +23,91 @@ class RegularExpression
 #endif
 	std::string tokenizedRPN;
 	std::vector<BaseElement> baseTokens;
+	// Replaces every list of code points and ranges of code points in braces, e.g. {a-zà-ÿ}, by the union of their UTF-8 encodings
+	// written with base elements of single bytes (see UTF8::byteRanges), and encloses in parentheses every code point of more than one byte
+	// which is a sequence of base elements by itself, so that the operators apply to the whole code point. Other base elements are not changed.
+	// A brace outside a base element always opens or closes a list, so a literal brace is listed: {{} is {, and a closing brace right after
+	// the opening one is listed as well, so {}} is } and {}{} is either of them.
+	std::string expandCodePoints(const std::string& regex)
+	{
+		auto decode = [&regex](std::size_t& i, std::size_t end) {
+			std::size_t len;
+			try
+			{
+				char32_t cp = UTF8::decode(std::string_view{regex}.substr(i, end - i), len);
+				i += len;
+				return cp;
+			}
+			catch(const std::invalid_argument&)
+			{
+				throw std::runtime_error("Bad regular expression: invalid UTF-8 at position " + std::to_string(i));
+			}
+		};
+		std::string expanded;
+		expanded.reserve(regex.size());
+		for(std::size_t i = 0; i < regex.size();)
+			if(regex[i] == Constants::RangeBegin)
+			{
+				std::size_t end = regex.find(Constants::RangeEnd, i + 2);
+				if(end == std::string::npos)
+					throw std::runtime_error("Bad regular expression: unclosed range");
+				std::vector<UTF8::ByteRanges> sequences;
+				for(i++; i < end;)
+				{
+					char32_t lo = decode(i, end), hi = lo;
+					if(i < end && regex[i] == Constants::RangeDelim)
+					{
+						if(++i == end)
+							throw std::runtime_error("Bad regular expression: missing end of range");
+						if((hi = decode(i, end)) < lo)
+							throw std::runtime_error("Bad regular expression: the end of a range is before its beginning");
+					}
+					UTF8::byteRanges(lo, hi, sequences);
+				}
+				i = end + 1;
+				if(sequences.empty())
+				{
+					expanded.push_back(Constants::EmptySet);
+					continue;
+				}
+				expanded.push_back(Constants::OpenParenthesis);
+				for(const UTF8::ByteRanges& sequence : sequences)
+				{
+					for(auto [first, last] : sequence)
+					{
+						expanded.push_back(Constants::OpenParenthesis);
+						for(unsigned b = first; b <= last; b++)
+						{
+							if(Constants::isSpecial(b) || Constants::isForbidden(b) || b == static_cast<USymbol>(Constants::BaseElementDelim))
+								throw std::runtime_error("Bad regular expression: a range contains a symbol with a special meaning");
+							expanded += BaseElement::ofSymbol(static_cast<Symbol>(b));
+							expanded.push_back(Constants::Union);
+						}
+						expanded.back() = Constants::CloseParenthesis;
+					}
+					expanded.push_back(Constants::Union);
+				}
+				expanded.back() = Constants::CloseParenthesis;
+			}
+			else if(std::size_t len = UTF8::length(static_cast<USymbol>(regex[i])); len > 1 && BaseElement::isBegin(regex[i]))
+			{
+				std::size_t begin = i;
+				decode(i, regex.size());
+				expanded.push_back(Constants::OpenParenthesis);
+				expanded.append(regex, begin, len);
+				expanded.push_back(Constants::CloseParenthesis);
+			}
+			else if(BaseElement::isBegin(regex[i]))
+			{
+				std::size_t end = std::find_if(regex.begin() + i, regex.end(), BaseElement::isEnd) - regex.begin();
+				end = std::min(end + 1, regex.size()); // an unclosed base element is reported by tokenize
+				expanded.append(regex, i, end - i);
+				i = end;
+			}
+			else
+				expanded.push_back(regex[i++]);
+		return expanded;
+	}
 	std::string tokenize(const std::string& regex)
 	{
 		std::string tokenizedRegex;
@@ -88,10 +174,10 @@ public:
 		if(regex.empty())
 			throw std::runtime_error("Empty regular expression");
 #	ifndef NDEBUG
-		tokenizedRegex = tokenize(regex);
+		tokenizedRegex = tokenize(expandCodePoints(regex));
 		produceRPN(tokenizedRegex);
 #	else
-		produceRPN(tokenize(regex));
+		produceRPN(tokenize(expandCodePoints(regex)));
 #	endif
 	}
 #ifndef NDEBUG
@@ -0,0 +1,401 @@
+#ifndef SEQUENTIALTRANSDUCER_HPP
+#define SEQUENTIALTRANSDUCER_HPP
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <span>
+#include <utility>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include "compiledBimachine.hpp"
+#include "denseDFA.hpp"
+#include "outputPool.hpp"
+#include "outputSink.hpp"
+#include "constants.hpp"
+
+// Resource caps for SequentialTransducer::determinize; exceeding one of them is reported as such, not as the function not being subsequential.
+struct DeterminizationLimits
+{
+	std::size_t max_states = 1 << 16; // of the sequential transducer
+	std::size_t max_delay = 1 << 12; // the longest output which may be held back
+	std::size_t max_pairs = 1 << 22; // of the pairs of states and of their delays explored by the twinning test
+};
+
+// Deterministic transducer with final outputs (subsequential transducer), computing the function of a bimachine in one left-to-right pass.
+// Every state is final, and every transition has exactly one output word.
+class SequentialTransducer
+{
+	DenseDFA::ColumnMap column_of; // column_of[c] == Constants::InvalidColumn <=> c is not in the alphabet
+	std::uint32_t columns_cnt = 0;
+	State states_cnt = 0;
+	std::vector<State> next; // [state][column]
+	std::vector<std::uint32_t> output; // [state][column] -> output id
+	std::vector<std::uint32_t> final; // [state] -> output id
+	OutputPool outputs;
+
+	SequentialTransducer() = default;
+
+	// The transducer whose states are the pairs (L, R) (see determinize) is unambiguous and all its states can reach a final one, so its function
+	// is subsequential iff it has the twinning property: whenever two runs on the same input u reach states p and q which have loops on the same input v,
+	// the delay of the runs, i.e. the difference of their outputs after their longest common prefix, is the same after u and after u v.
+	// The pairs of runs are explored from the pairs of initial states; a pair is in a state (L, R1, R2), since the left automaton is deterministic.
+	// Appending outputs to a delay is invertible, so every cycle keeps every delay entering a strongly connected component of these states iff
+	// the delays propagated from it along the edges inside the component agree. The components are processed in topological order and
+	// only the delays reaching components with cycles are computed.
+	// reachable, previous and symbol_of_column are as in determinize.
+	static bool twinned(const CompiledBimachineWithFinalOutput& bm, const std::vector<State>& reachable, const std::vector<std::vector<State>>& previous,
+						const std::vector<Symbol>& symbol_of_column, const DeterminizationLimits& limits)
+	{
+		const DenseDFA& left = bm.left;
+		const std::uint64_t R_cnt = bm.right.states();
+		struct PairState
+		{
+			State L, R1, R2;
+		};
+		struct PairEdge
+		{
+			std::uint32_t c, to;
+		};
+		constexpr std::uint32_t Unvisited = -1;
+		std::vector<PairState> pairs;
+		std::vector<std::uint32_t> order, low, component_of; // for Tarjan's algorithm
+		std::vector<char> reaches_cycle;
+		std::unordered_map<std::uint64_t, std::uint32_t> index_of;
+		auto add = [&](State L, State R1, State R2) {
+			auto [it, inserted] = index_of.try_emplace((L * R_cnt + R1) * R_cnt + R2, pairs.size());
+			if(inserted)
+			{
+				if(pairs.size() == limits.max_pairs)
+					throw std::length_error("the twinning test exceeds the limit on the number of pairs of states");
+				pairs.push_back({L, R1, R2});
+				order.push_back(Unvisited);
+				low.push_back(Unvisited);
+				component_of.push_back(Unvisited);
+				reaches_cycle.push_back(false);
+			}
+			return it->second;
+		};
+		// the edges are not stored; those leaving pairs[from] are enumerated by the class and the indices in the two lists of previous
+		struct EdgeCursor
+		{
+			std::uint32_t from, c = 0, i1 = 0, i2 = 0;
+		};
+		// the edge at cursor, which is advanced past it, or nullopt after the last one
+		auto next_edge = [&](EdgeCursor& cursor) -> std::optional<PairEdge> {
+			const auto [L, R1, R2] = pairs[cursor.from];
+			for(; cursor.c < bm.classes_cnt; cursor.c++, cursor.i1 = 0)
+			{
+				const std::vector<State>& next_R1 = previous[R1 * bm.classes_cnt + cursor.c];
+				const std::vector<State>& next_R2 = previous[R2 * bm.classes_cnt + cursor.c];
+				for(; cursor.i1 < next_R1.size(); cursor.i1++, cursor.i2 = 0)
+					if(cursor.i2 < next_R2.size())
+						return PairEdge{cursor.c, add(left.next(L, cursor.c), next_R1[cursor.i1], next_R2[cursor.i2++])};
+			}
+			return std::nullopt;
+		};
+		for(State R1 : reachable)
+			for(State R2 : reachable)
+				add(left.initial(), R1, R2);
+		const std::uint32_t initial_cnt = pairs.size();
+
+		// Tarjan's algorithm explores the pairs; the components are found in reverse topological order
+		std::vector<std::uint32_t> members, members_begin; // members[members_begin[k], members_begin[k + 1]) is the k-th component
+		std::vector<char> relevant; // the component has a cycle or leads to one
+		{
+			std::vector<std::uint32_t> stack;
+			std::vector<EdgeCursor> calls;
+			std::uint32_t visited = 0;
+			auto visit = [&](std::uint32_t v) {
+				order[v] = low[v] = visited++;
+				stack.push_back(v);
+				calls.push_back({v});
+			};
+			for(std::uint32_t root = 0; root < initial_cnt; root++)
+			{
+				if(order[root] != Unvisited)
+					continue;
+				visit(root);
+				while(!calls.empty())
+				{
+					const std::uint32_t v = calls.back().from;
+					if(std::optional<PairEdge> edge = next_edge(calls.back()))
+					{
+						const std::uint32_t w = edge->to;
+						if(order[w] == Unvisited)
+							visit(w);
+						else if(component_of[w] == Unvisited)
+						{
+							low[v] = std::min(low[v], order[w]);
+							reaches_cycle[v] |= v == w;
+						}
+						else
+							reaches_cycle[v] |= relevant[component_of[w]];
+						continue;
+					}
+					if(low[v] == order[v])
+					{
+						const std::size_t begin = members.size();
+						members_begin.push_back(begin);
+						bool leads = false;
+						std::uint32_t w;
+						do
+						{
+							w = stack.back();
+							stack.pop_back();
+							component_of[w] = relevant.size();
+							members.push_back(w);
+							leads |= reaches_cycle[w];
+						} while(w != v);
+						relevant.push_back(leads || members.size() - begin > 1);
+						reaches_cycle[v] = relevant.back();
+					}
+					calls.pop_back();
+					if(!calls.empty())
+					{
+						const std::uint32_t parent = calls.back().from;
+						low[parent] = std::min(low[parent], low[v]);
+						reaches_cycle[parent] |= reaches_cycle[v];
+					}
+				}
+			}
+			members_begin.push_back(members.size());
+		}
+
+		std::vector<std::vector<Symbol>> symbols_of_class(bm.classes_cnt);
+		for(Symbol a : symbol_of_column)
+			symbols_of_class[bm.class_of[static_cast<USymbol>(a)]].push_back(a);
+		using delay_t = std::pair<Word, Word>;
+		std::unordered_map<std::uint32_t, std::vector<delay_t>> delays_of; // of the runs reaching the pairs of states in the relevant components
+		for(std::uint32_t i = 0; i < initial_cnt; i++)
+			if(relevant[component_of[i]])
+				delays_of[i].emplace_back();
+		std::size_t delays_cnt = initial_cnt;
+		auto add_delay = [&](std::uint32_t i, delay_t&& delay) {
+			std::vector<delay_t>& delays = delays_of[i];
+			if(std::ranges::find(delays, delay) != delays.end())
+				return;
+			if(++delays_cnt > limits.max_pairs)
+				throw std::length_error("the twinning test exceeds the limit on the number of delays");
+			delays.push_back(std::move(delay));
+		};
+		// calls f(delay after edge) for every symbol of the class of edge, which leaves pairs[from] with delay
+		auto for_each_step = [&](std::uint32_t from, const delay_t& delay, const PairEdge& edge, auto f) {
+			const State L = pairs[from].L;
+			for(Symbol a : symbols_of_class[edge.c])
+			{
+				auto output = [&](State R) {
+					std::uint32_t out = bm.psi[bm.psi_index(L, edge.c, R)];
+					return out == OutputPool::Identity ? Word(1, a) : Word{bm.outputs[out]};
+				};
+				delay_t next{delay.first + output(pairs[edge.to].R1), delay.second + output(pairs[edge.to].R2)};
+				std::size_t common = std::ranges::mismatch(next.first, next.second).in1 - next.first.begin();
+				next.first.erase(0, common);
+				next.second.erase(0, common);
+				if(std::max(next.first.size(), next.second.size()) > limits.max_delay)
+					throw std::length_error("the twinning test exceeds the limit on the delay");
+				f(std::move(next));
+			}
+		};
+
+		std::vector<std::uint32_t> position(pairs.size()); // in its component
+		std::vector<std::vector<delay_t>> entering;
+		std::vector<std::optional<delay_t>> propagated;
+		std::vector<std::uint32_t> queue;
+		for(std::size_t k = relevant.size(); k-- > 0;)
+		{
+			if(!relevant[k])
+				continue;
+			const std::span<const std::uint32_t> component(members.data() + members_begin[k], members.data() + members_begin[k + 1]);
+			entering.assign(component.size(), {});
+			for(std::uint32_t i = 0; i < component.size(); i++)
+			{
+				position[component[i]] = i;
+				std::swap(entering[i], delays_of[component[i]]);
+			}
+			for(std::uint32_t i = 0; i < component.size(); i++)
+				for(const delay_t& delay : entering[i])
+				{
+					if(std::ranges::find(delays_of[component[i]], delay) != delays_of[component[i]].end())
+						continue; // propagated from another delay already
+					propagated.assign(component.size(), std::nullopt);
+					propagated[i] = delay;
+					queue.assign(1, i);
+					bool agree = true;
+					// the delays also leave the component along the edges to the later ones
+					for(std::size_t q = 0; q < queue.size() && agree; q++)
+						for(EdgeCursor cursor{component[queue[q]]}; std::optional<PairEdge> edge = next_edge(cursor);)
+							if(component_of[edge->to] == k)
+								for_each_step(cursor.from, *propagated[queue[q]], *edge, [&](delay_t&& next) {
+									std::optional<delay_t>& target = propagated[position[edge->to]];
+									if(!target)
+									{
+										target = std::move(next);
+										queue.push_back(position[edge->to]);
+									}
+									else if(*target != next)
+										agree = false;
+								});
+							else if(relevant[component_of[edge->to]])
+								for_each_step(cursor.from, *propagated[queue[q]], *edge, [&](delay_t&& next) { add_delay(edge->to, std::move(next)); });
+					if(!agree)
+						return false;
+					for(std::uint32_t j = 0; j < component.size(); j++)
+						add_delay(component[j], std::move(*propagated[j]));
+				}
+		}
+		return true;
+	}
+public:
+	// The bimachine is turned into an unambiguous transducer whose states are pairs (L, R) of a left state and a guessed right state, i.e. the state
+	// of the right automaton after the rest of the input, which is then determinized by the subset construction with delayed outputs.
+	// A state of the result is the left state together with the possible right states, each with the output which is not emitted yet.
+	// Returns std::nullopt if the function of bm is not subsequential, which is decided by the twinning test before determinizing.
+	// Throws std::length_error if the test or the determinization exceeds limits.
+	static std::optional<SequentialTransducer> determinize(const CompiledBimachineWithFinalOutput& bm, const DeterminizationLimits& limits = {})
+	{
+		SequentialTransducer result;
+		const DenseDFA& left = bm.left;
+		const DenseDFA& right = bm.right;
+
+		// the symbols of the alphabet are the columns, since the outputs for symbols of the same class of bm may differ in the symbol itself
+		std::vector<Symbol> symbol_of_column;
+		result.column_of.fill(Constants::InvalidColumn);
+		for(std::size_t a = 0; a < result.column_of.size(); a++)
+			if(bm.class_of[a] != Constants::InvalidColumn)
+			{
+				result.column_of[a] = symbol_of_column.size();
+				symbol_of_column.push_back(static_cast<Symbol>(a));
+			}
+		result.columns_cnt = symbol_of_column.size();
+
+		// only the right states reachable from the initial one can be the state after the rest of the input
+		std::vector<State> reachable{right.initial()};
+		std::vector<bool> is_reachable(right.states());
+		is_reachable[right.initial()] = true;
+		for(std::size_t i = 0; i < reachable.size(); i++)
+			for(std::uint32_t c = 0; c < bm.classes_cnt; c++)
+				if(State R = right.next(reachable[i], c); !is_reachable[R])
+				{
+					is_reachable[R] = true;
+					reachable.push_back(R);
+				}
+		std::ranges::sort(reachable);
+		// previous[R * classes_cnt + c] are the reachable states from which c leads to R
+		std::vector<std::vector<State>> previous(static_cast<std::size_t>(right.states()) * bm.classes_cnt);
+		for(State R : reachable)
+			for(std::uint32_t c = 0; c < bm.classes_cnt; c++)
+				previous[right.next(R, c) * bm.classes_cnt + c].push_back(R);
+		if(!twinned(bm, reachable, previous, symbol_of_column, limits))
+			return std::nullopt;
+
+		using subset_t = std::pair<State, std::vector<std::pair<State, Word>>>; // (left state, sorted (right state, delayed output))
+		std::map<subset_t, State> index_of;
+		std::vector<const subset_t*> subset_of;
+		auto add = [&](subset_t&& subset) {
+			auto [it, inserted] = index_of.try_emplace(std::move(subset), subset_of.size());
+			if(inserted)
+			{
+				if(subset_of.size() == limits.max_states)
+					throw std::length_error("the sequential transducer exceeds the limit on the number of states");
+				subset_of.push_back(&it->first);
+			}
+			return it->second;
+		};
+		subset_t initial{left.initial(), {}};
+		for(State R : reachable)
+			initial.second.emplace_back(R, Word{});
+		add(std::move(initial));
+
+		for(State st = 0; st < subset_of.size(); st++)
+		{
+			const auto& [L, delayed] = *subset_of[st];
+			for(std::uint32_t column = 0; column < result.columns_cnt; column++)
+			{
+				Symbol a = symbol_of_column[column];
+				std::uint32_t c = bm.class_of[static_cast<USymbol>(a)];
+				// the right state R before a was guessed; the guesses for the state after a are the states from which a leads to R
+				std::vector<std::pair<State, Word>> candidates;
+				for(const auto& [R, w] : delayed)
+					for(State next_R : previous[R * bm.classes_cnt + c])
+					{
+						std::uint32_t out = bm.psi[bm.psi_index(L, c, next_R)];
+						candidates.emplace_back(next_R, out == OutputPool::Identity ? w + a : w + Word{bm.outputs[out]});
+					}
+				if(candidates.empty())
+					throw std::logic_error("no run of the bimachine continues with '" + std::string{a} + "'");
+				// the longest common prefix of the candidates can be emitted now
+				std::size_t common = candidates[0].second.size();
+				for(const auto& [R, w] : candidates)
+				{
+					std::string_view prefix = std::string_view{w}.substr(0, common);
+					common = std::ranges::mismatch(prefix, candidates[0].second).in1 - prefix.begin();
+				}
+				Word emitted = candidates[0].second.substr(0, common);
+				for(auto& [R, w] : candidates)
+				{
+					w.erase(0, common);
+					if(w.size() > limits.max_delay)
+						throw std::length_error("the sequential transducer exceeds the limit on the delayed output");
+				}
+				std::ranges::sort(candidates);
+				result.next.push_back(add({left.next(L, c), std::move(candidates)}));
+				result.output.push_back(result.outputs.intern(emitted));
+			}
+		}
+
+		result.states_cnt = subset_of.size();
+		for(const subset_t* subset : subset_of)
+		{
+			const auto& [L, delayed] = *subset;
+			// at the end of the input the right state is the initial one
+			auto it = std::ranges::find(delayed, right.initial(), &std::pair<State, Word>::first);
+			if(it == delayed.end())
+				throw std::logic_error("the initial right state is not among the guesses");
+			result.final.push_back(result.outputs.intern(it->second + Word{bm.outputs[bm.iota[L]]}));
+		}
+		return result;
+	}
+
+	State initial() const noexcept { return 0; }
+	// appends the output for s read in st and returns the next state
+	template<OutputSink Sink>
+	State step(State st, Symbol s, Sink& sink) const
+	{
+		std::uint32_t column = column_of[static_cast<USymbol>(s)];
+		if(column == Constants::InvalidColumn)
+			throw std::invalid_argument("cannot get successor: '" + std::string{s} + "' is not in the alphabet");
+		std::size_t index = static_cast<std::size_t>(st) * columns_cnt + column;
+		sink.append(outputs[output[index]]);
+		return next[index];
+	}
+	// appends the final output of st, i.e. the output when the input ends in st
+	void finish(State st, OutputSink auto& sink) const
+	{
+		sink.append(outputs[final[st]]);
+	}
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink) const
+	{
+		State st = initial();
+		for(Symbol s : input)
+			st = step(st, s, sink);
+		finish(st, sink);
+	}
+	Word operator()(const Word& input) const
+	{
+		Word result;
+		result.reserve(input.size());
+		(*this)(std::string_view{input}, result);
+		return result;
+	}
+
+	State StatesCnt() const noexcept { return states_cnt; }
+};
+
+#endif
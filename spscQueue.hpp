@@ -0,0 +1,47 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <bit>
+#include <algorithm>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// push blocks while the queue is full and pop blocks while it is empty; both wait on the atomics instead of spinning.
+template<class T>
+class SpscQueue
+{
+	std::vector<T> slots;
+	std::size_t mask;
+	alignas(64) std::atomic<std::size_t> head{0}; // the next slot to pop; written only by the consumer
+	alignas(64) std::atomic<std::size_t> tail{0}; // the next slot to push; written only by the producer
+public:
+	// the capacity is rounded up to a power of 2
+	explicit SpscQueue(std::size_t capacity): slots(std::bit_ceil(std::max<std::size_t>(capacity, 1))), mask(slots.size() - 1) {}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	void push(T value)
+	{
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		for(std::size_t h = head.load(std::memory_order_acquire); t - h == slots.size(); h = head.load(std::memory_order_acquire))
+			head.wait(h, std::memory_order_acquire);
+		slots[t & mask] = std::move(value);
+		tail.store(t + 1, std::memory_order_release);
+		tail.notify_one();
+	}
+	T pop()
+	{
+		std::size_t h = head.load(std::memory_order_relaxed);
+		for(std::size_t t = tail.load(std::memory_order_acquire); t == h; t = tail.load(std::memory_order_acquire))
+			tail.wait(t, std::memory_order_acquire);
+		T value = std::move(slots[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		head.notify_one();
+		return value;
+	}
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstddef>
+#include <stdexcept>
+#include "compiledBimachine.hpp"
+#include "compiledTwostepBimachine.hpp"
+#include "PorterStemmer.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp checkpointedTest.cpp
+// checks apply_checkpointed of both kinds of compiled bimachines against operator() for blocks of one symbol, of two symbols and longer than the input;
+// returns a nonzero status if any check fails
+
+std::vector<std::string> inputs(const std::string& symbols)
+{
+	std::mt19937 gen(5);
+	std::vector<std::string> result{""};
+	for(std::size_t size : {1, 2, 3, 17, 1000})
+	{
+		std::string text;
+		for(std::size_t i = 0; i < size; i++)
+			text.push_back(symbols[std::uniform_int_distribution<std::size_t>(0, symbols.size() - 1)(gen)]);
+		result.push_back(text);
+	}
+	return result;
+}
+
+template<class Bimachine>
+bool check(const std::string& name, const Bimachine& bm, const std::vector<std::string>& inputs)
+{
+	for(const std::string& input : inputs)
+		for(std::size_t block_size : {std::size_t(1), std::size_t(2), std::size_t(7), input.size(), input.size() + 1, std::size_t(1) << 20})
+		{
+			if(!block_size)
+				continue;
+			Word output;
+			bm.apply_checkpointed(input, output, block_size);
+			if(output != bm(input))
+			{
+				std::cerr << name << ": apply_checkpointed with blocks of " << block_size << " on an input of " << input.size() << " symbols differs from operator()\n";
+				return false;
+			}
+		}
+	try
+	{
+		Word output;
+		bm.apply_checkpointed("", output, 0);
+		std::cerr << name << ": apply_checkpointed accepts blocks of 0 symbols\n";
+		return false;
+	}
+	catch(const std::invalid_argument&)
+	{
+		return true;
+	}
+}
+
+int main()
+{
+	const std::vector<std::string> words = inputs("aeiostyz  \n");
+	bool ok = true;
+	for(std::size_t i = 0; i < PorterStemmer::steps_cnt; i++)
+	{
+		std::vector<ContextualReplacementRuleRepresentation> batch, twostep_batch;
+		for(const auto& rule : PorterStemmer::steps[i])
+		{
+			batch.emplace_back(rule, PorterStemmer::alphabet);
+			twostep_batch.emplace_back(rule, PorterStemmer::alphabet);
+		}
+		ok &= check("step " + std::to_string(i), CompiledBimachineWithFinalOutput(std::move(batch)), words);
+		ok &= check("two-step step " + std::to_string(i), CompiledTwostepBimachine(twostep_batch), words);
+	}
+	// y is inserted after every b, so the output ends with the final output iff the input ends with b
+	std::vector<ContextualReplacementRuleRepresentation> after_b;
+	after_b.emplace_back(ContextualReplacementRule{std::string("[_,y]"), std::string("b"), std::string("_")}, std::string("ab"));
+	const std::vector<std::string> abs = inputs("ab");
+	ok &= check("two-step insertion after b", CompiledTwostepBimachine(after_b), abs);
+	ok &= check("insertion after b", CompiledBimachineWithFinalOutput(std::move(after_b)), abs);
+	std::cerr << (ok ? "all checks passed\n" : "some checks failed\n");
+	return ok ? 0 : 1;
+}
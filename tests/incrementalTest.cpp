@@ -0,0 +1,148 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <random>
+#include <cstddef>
+#include "incrementalBimachine.hpp"
+#include "PorterStemmer.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp incrementalTest.cpp
+// applies random edits through IncrementalBimachine and IncrementalCascade and compares the outputs and the returned edits with a full recompute;
+// returns a nonzero status if any check fails
+
+std::mt19937 gen(11);
+
+std::size_t uniform(std::size_t from, std::size_t to)
+{
+	return std::uniform_int_distribution<std::size_t>(from, to)(gen);
+}
+
+Word random_text(std::string_view symbols, std::size_t size)
+{
+	Word text;
+	for(std::size_t i = 0; i < size; i++)
+		text.push_back(symbols[uniform(0, symbols.size() - 1)]);
+	return text;
+}
+
+struct RandomEdit
+{
+	std::size_t pos, length;
+	Word replacement;
+};
+
+// edits at the start, at the end, long deletions which empty whole blocks, and short replacements anywhere
+RandomEdit random_edit(std::size_t text_size, std::size_t block_size, std::string_view symbols)
+{
+	RandomEdit edit;
+	std::size_t max_length = std::min(text_size, uniform(0, 3) ? 8 : 3 * block_size + 2);
+	edit.length = uniform(0, max_length);
+	switch(uniform(0, 3))
+	{
+	case 0:
+		edit.pos = 0;
+		break;
+	case 1:
+		edit.pos = text_size - edit.length;
+		break;
+	default:
+		edit.pos = uniform(0, text_size - edit.length);
+	}
+	edit.replacement = random_text(symbols, uniform(0, 3) ? uniform(0, 8) : 0);
+	return edit;
+}
+
+// the returned edit must turn the previous output into the new one, and it must not replace a symbol by itself at either end
+bool check_edit(const std::string& name, Word previous, const Edit& change, const Word& expected)
+{
+	bool trimmed = !change.length || change.replacement.empty() ||
+		(previous[change.offset] != change.replacement.front() && previous[change.offset + change.length - 1] != change.replacement.back());
+	if(change.offset > previous.size() || change.length > previous.size() - change.offset || !trimmed)
+	{
+		std::cerr << name << ": the returned edit is not a trimmed edit of the previous output\n";
+		return false;
+	}
+	if(previous.replace(change.offset, change.length, change.replacement) != expected)
+	{
+		std::cerr << name << ": the returned edit does not give the new output\n";
+		return false;
+	}
+	return true;
+}
+
+template<class Incremental, class Recompute>
+bool check(const std::string& name, Incremental& incremental, Word text, std::size_t block_size, std::string_view symbols, Recompute recompute)
+{
+	for(std::size_t i = 0; i < 300; i++)
+	{
+		RandomEdit edit = random_edit(text.size(), block_size, symbols);
+		Word previous = incremental.Output();
+		Edit change = incremental.replace(edit.pos, edit.length, edit.replacement);
+		text.replace(edit.pos, edit.length, edit.replacement);
+		Word expected = recompute(text);
+		if(incremental.Text() != text || incremental.Output() != expected)
+		{
+			std::cerr << name << ": the text or the output differs from a full recompute after edit " << i << "\n";
+			return false;
+		}
+		if(!check_edit(name, std::move(previous), change, expected))
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	std::vector<CompiledBimachineWithFinalOutput> steps;
+	for(std::size_t i = 0; i < PorterStemmer::steps_cnt; i++)
+	{
+		std::vector<ContextualReplacementRuleRepresentation> batch;
+		for(const auto& rule : PorterStemmer::steps[i])
+			batch.emplace_back(rule, PorterStemmer::alphabet);
+		steps.emplace_back(std::move(batch));
+	}
+	// y is inserted after every b, so the final output is y iff the text ends with b
+	std::vector<ContextualReplacementRuleRepresentation> after_b;
+	after_b.emplace_back(ContextualReplacementRule{std::string("[_,y]"), std::string("b"), std::string("_")}, std::string("ab"));
+	const CompiledBimachineWithFinalOutput insert_after_b(std::move(after_b));
+
+	const std::string_view words = "aeiostyz  \n", ab = "ab";
+	bool ok = true;
+	for(std::size_t block_size : {1, 2, 5, 64})
+	{
+		const std::string suffix = " with blocks of " + std::to_string(block_size);
+		{
+			Word text = random_text(ab, 40);
+			IncrementalBimachine incremental(insert_after_b, text, block_size);
+			ok &= check("insertion after b" + suffix, incremental, text, block_size, ab, [&](const Word& text) { return insert_after_b(text); });
+		}
+		for(std::size_t i = 0; i < steps.size(); i++)
+		{
+			Word text = random_text(words, 120);
+			IncrementalBimachine incremental(steps[i], text, block_size);
+			ok &= check("step " + std::to_string(i) + suffix, incremental, text, block_size, words, [&](const Word& text) { return steps[i](text); });
+		}
+		{
+			Word text = random_text(words, 120);
+			IncrementalCascade incremental(steps, text, block_size);
+			ok &= check("cascade" + suffix, incremental, text, block_size, words, [&](Word text) {
+				for(const auto& step : steps)
+					text = step(text);
+				return text;
+			});
+		}
+	}
+	{
+		Word text = random_text(words, 30);
+		IncrementalCascade incremental({}, text);
+		ok &= check("empty cascade", incremental, text, 1 << 12, words, [](const Word& text) { return text; });
+	}
+	{
+		// an empty text has no blocks until something is inserted
+		IncrementalBimachine incremental(insert_after_b, "", 3);
+		ok &= check("insertion after b from an empty text", incremental, Word{}, 3, ab, [&](const Word& text) { return insert_after_b(text); });
+	}
+	std::cerr << (ok ? "all checks passed\n" : "some checks failed\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#include <iostream>
+#include <vector>
+#include <optional>
+#include <cstddef>
+#include "denseDFA.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp lookaheadTest.cpp
+// checks DenseDFA::lookahead on small automata whose lookahead is known; returns a nonzero status if any check fails
+
+DenseDFA automaton(State statesCnt, State initial, std::vector<State> table)
+{
+	DenseDFA::ColumnMap columns;
+	columns.fill(Constants::InvalidColumn);
+	columns['c'] = 0;
+	columns['d'] = 1;
+	return DenseDFA(columns, 2, statesCnt, initial, std::move(table));
+}
+
+bool check(const char* name, const DenseDFA& dfa, std::vector<State> color, std::optional<std::size_t> expected)
+{
+	std::optional<std::size_t> k = dfa.lookahead(std::move(color));
+	if(k == expected)
+		return true;
+	std::cerr << name << ": expected " << (expected ? std::to_string(*expected) : "unbounded") << ", got " << (k ? std::to_string(*k) : "unbounded") << "\n";
+	return false;
+}
+
+int main()
+{
+	bool ok = true;
+	// the state is the last symbol read: 0 before any, 1 after c, 2 after d
+	ok &= check("last symbol", automaton(3, 0, {1, 2, 1, 2, 1, 2}), {0, 1, 2}, 1);
+	// A = 0, B = 1, C = 2 with the colors of A and B equal; c: A -> A, B -> C, C -> A; d: A -> A, B -> B, C -> A; B is initial.
+	// After d the possible states are A and B, which have the same color, but after d c or d...d c they are A and C,
+	// so the lookahead is unbounded; the colors must be refined before the sets of states are checked.
+	ok &= check("split after a uniform set", automaton(3, 1, {0, 0, 2, 1, 0, 0}), {0, 0, 1}, std::nullopt);
+	std::cerr << (ok ? "all checks passed\n" : "some checks failed\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <optional>
+#include <cstddef>
+#include "compiledBimachine.hpp"
+#include "compiledTwostepBimachine.hpp"
+#include "PorterStemmer.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp parallelTest.cpp
+// checks the parallel applications of both kinds of compiled bimachines against operator() on inputs spanning several chunks; returns a nonzero status if any check fails
+
+// words of random letters separated by single spaces or newlines, and one word longer than a chunk, so that some chunks have no synchronizing symbol
+std::vector<std::string> inputs()
+{
+	std::mt19937 gen(7);
+	std::vector<std::string> result{"", "a", "ab c"};
+	for(std::size_t words_cnt : {10, 200, 3000})
+	{
+		std::string text;
+		for(std::size_t i = 0; i < words_cnt; i++)
+		{
+			for(std::size_t j = std::uniform_int_distribution<std::size_t>(1, 12)(gen); j > 0; j--)
+				text.push_back('a' + std::uniform_int_distribution<int>(0, 25)(gen));
+			text.push_back(gen() % 8 ? ' ' : '\n');
+		}
+		result.push_back(text);
+	}
+	result.push_back(result.back() + std::string(5000, 'e') + "s " + result[4]);
+	return result;
+}
+
+// apply_parallel must give the output of operator() if bm is splittable and std::nullopt otherwise
+bool check_parallel(const char* name, const CompiledBimachineWithFinalOutput& bm, const std::vector<std::string>& inputs, bool splittable, ThreadPool& pool)
+{
+	for(const std::string& input : inputs)
+		for(std::size_t chunks_cnt : {0, 1, 2, 7, 64})
+		{
+			std::optional<Word> output = bm.apply_parallel(input, pool, chunks_cnt);
+			if(output.has_value() != splittable || (output && *output != bm(input)))
+			{
+				std::cerr << name << ": apply_parallel with " << chunks_cnt << " chunks on an input of " << input.size() << " symbols "
+					<< (output ? "differs from operator()" : "was not applied") << "\n";
+				return false;
+			}
+		}
+	return true;
+}
+
+// apply_enumerative must give the output of operator() for any bimachine
+template<class Bimachine>
+bool check_enumerative(const std::string& name, const Bimachine& bm, const std::vector<std::string>& inputs, ThreadPool& pool)
+{
+	for(const std::string& input : inputs)
+		for(std::size_t chunks_cnt : {0, 1, 2, 7, 64})
+			if(bm.apply_enumerative(input, pool, chunks_cnt) != bm(input))
+			{
+				std::cerr << name << ": apply_enumerative with " << chunks_cnt << " chunks on an input of " << input.size() << " symbols differs from operator()\n";
+				return false;
+			}
+	return true;
+}
+
+int main()
+{
+	std::vector<CompiledBimachineWithFinalOutput> steps;
+	std::vector<CompiledTwostepBimachine> twostep_steps;
+	for(std::size_t i = 0; i < PorterStemmer::steps_cnt; i++)
+	{
+		std::vector<ContextualReplacementRuleRepresentation> batch, twostep_batch;
+		for(const auto& rule : PorterStemmer::steps[i])
+		{
+			batch.emplace_back(rule, PorterStemmer::alphabet);
+			twostep_batch.emplace_back(rule, PorterStemmer::alphabet);
+		}
+		steps.emplace_back(std::move(batch));
+		twostep_steps.emplace_back(std::move(twostep_batch));
+	}
+	// the pairs of a's are replaced from the left, so whether an a is replaced depends on the parity of the a's before it
+	// and no symbol synchronizes the left automaton
+	std::vector<ContextualReplacementRuleRepresentation> pairs;
+	pairs.emplace_back(ContextualReplacementRule{std::string("[aa,x]"), std::string("_"), std::string("_")}, std::string("a"));
+	const CompiledTwostepBimachine twostep_not_splittable(pairs);
+	const CompiledBimachineWithFinalOutput not_splittable(std::move(pairs));
+
+	const std::vector<std::string> texts = inputs(), as{"", "a", "aaa", std::string(1001, 'a')};
+	bool ok = true;
+	ThreadPool pool(3);
+	for(std::size_t i = 0; i < steps.size(); i++)
+		ok &= check_parallel(("step " + std::to_string(i)).c_str(), steps[i], texts, true, pool);
+	ok &= check_parallel("pairs of a's", not_splittable, as, false, pool);
+	for(std::size_t i = 0; i < steps.size(); i++)
+	{
+		ok &= check_enumerative("step " + std::to_string(i), steps[i], texts, pool);
+		ok &= check_enumerative("two-step step " + std::to_string(i), twostep_steps[i], texts, pool);
+	}
+	ok &= check_enumerative("pairs of a's", not_splittable, as, pool);
+	ok &= check_enumerative("two-step pairs of a's", twostep_not_splittable, as, pool);
+	std::cerr << (ok ? "all checks passed\n" : "some checks failed\n");
+	return ok ? 0 : 1;
+}
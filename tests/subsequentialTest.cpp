@@ -0,0 +1,51 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <exception>
+#include "sequentialTransducer.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp subsequentialTest.cpp
+// checks SequentialTransducer::determinize on rules whose subsequentiality is known; returns a nonzero status if any check fails
+
+// subsequential: whether determinize must succeed; if it does, the result must agree with the bimachine on input
+bool check(const char* name, std::string left_context, std::string right_context, bool subsequential, const std::string& input)
+{
+	std::vector<ContextualReplacementRuleRepresentation> batch;
+	batch.emplace_back(ContextualReplacementRule{std::string("[a,x]"), std::move(left_context), std::move(right_context)}, std::string("abc"));
+	CompiledBimachineWithFinalOutput bm(batch);
+	try
+	{
+		auto transducer = SequentialTransducer::determinize(bm);
+		if(!transducer != !subsequential)
+		{
+			std::cerr << name << ": expected " << (subsequential ? "" : "not ") << "to be subsequential\n";
+			return false;
+		}
+		if(transducer && (*transducer)(input) != bm(input))
+		{
+			std::cerr << name << ": the outputs on \"" << input << "\" differ\n";
+			return false;
+		}
+		return true;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << name << ": " << e.what() << "\n";
+		return false;
+	}
+}
+
+int main()
+{
+	bool ok = true;
+	// whether a is replaced depends on a suffix of unbounded length
+	ok &= check("unbounded right context", "_", "b*c", false, "");
+	ok &= check("unbounded periodic right context", "_", "(bb)*c", false, "");
+	// the left context is read by the left automaton, so nothing has to be delayed
+	ok &= check("left context", "(a*ba*b)*a*ba*", "_", true, "abbbcabbab");
+	ok &= check("short right context", "_", "bc", true, "abcabbab");
+	// the delay is long but bounded, so a limit on it must not be taken as the function not being subsequential
+	ok &= check("long right context", "_", std::string(300, 'b') + "c", true, "a" + std::string(300, 'b') + "cab");
+	std::cerr << (ok ? "all checks passed\n" : "some checks failed\n");
+	return ok ? 0 : 1;
+}
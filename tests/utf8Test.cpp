@@ -0,0 +1,139 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <set>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include "utf8.hpp"
+#include "compiledBimachine.hpp"
+
+// g++ -Wall -pedantic-errors -O3 -std=c++23 -I.. ../constants.cpp utf8Test.cpp
+// checks the byte ranges of code point ranges at and across the boundaries of the encoding lengths, and rules whose contexts are such ranges
+// or list braces; returns a nonzero status if any check fails
+
+// e.g. U+07FF-U+0800
+std::string name(char32_t lo, char32_t hi)
+{
+	std::ostringstream os;
+	os << std::hex << std::uppercase << std::setfill('0') << "U+" << std::setw(4) << static_cast<std::uint32_t>(lo) << "-U+" << std::setw(4) << static_cast<std::uint32_t>(hi);
+	return os.str();
+}
+
+bool encodable(char32_t cp)
+{
+	return cp <= UTF8::MaxCodePoint && (cp < UTF8::SurrogatesBegin || cp > UTF8::SurrogatesEnd);
+}
+
+bool matches(const UTF8::ByteRanges& ranges, const std::string& bytes)
+{
+	if(ranges.size() != bytes.size())
+		return false;
+	for(std::size_t i = 0; i < bytes.size(); i++)
+		if(static_cast<USymbol>(bytes[i]) < ranges[i].first || static_cast<USymbol>(bytes[i]) > ranges[i].second)
+			return false;
+	return true;
+}
+
+// every code point of [lo, hi] must match exactly one sequence and the sequences must have no other words,
+// i.e. every code point matches one and the sizes of the products add up to the number of code points
+bool check_byte_ranges(char32_t lo, char32_t hi)
+{
+	std::vector<UTF8::ByteRanges> sequences;
+	UTF8::byteRanges(lo, hi, sequences);
+	std::size_t products = 0, cps = 0;
+	for(const UTF8::ByteRanges& ranges : sequences)
+	{
+		std::size_t product = 1;
+		for(auto [first, last] : ranges)
+			product *= last - first + 1;
+		products += product;
+	}
+	for(char32_t cp = lo; cp <= hi; cp++)
+	{
+		if(!encodable(cp))
+			continue;
+		cps++;
+		std::string bytes = UTF8::encode(cp);
+		std::size_t i = 0;
+		while(i < sequences.size() && !matches(sequences[i], bytes))
+			i++;
+		if(i == sequences.size())
+		{
+			std::cerr << name(lo, hi) << ": " << name(cp, cp) << " has no byte ranges\n";
+			return false;
+		}
+	}
+	if(products != cps)
+	{
+		std::cerr << name(lo, hi) << ": the byte ranges have " << products << " words for " << cps << " code points\n";
+		return false;
+	}
+	return true;
+}
+
+// [a,x] with the left context lctx must replace the a after a probe exactly if expected(probe)
+template<class Expected>
+bool check_rule(const std::string& name, const std::string& lctx, const std::vector<std::string>& probes, const std::string& alphabet, Expected expected)
+{
+	try
+	{
+		std::vector<ContextualReplacementRuleRepresentation> batch;
+		batch.emplace_back(ContextualReplacementRule{std::string("[a,x]"), lctx, std::string("_")}, alphabet);
+		const CompiledBimachineWithFinalOutput bm(std::move(batch));
+		for(const std::string& probe : probes)
+			if(bm(probe + "a") != probe + (expected(probe) ? "x" : "a"))
+			{
+				std::cerr << name << ": the a after the probe of " << probe.size() << " bytes is " << (expected(probe) ? "not " : "") << "replaced\n";
+				return false;
+			}
+		return true;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << name << ": " << e.what() << "\n";
+		return false;
+	}
+}
+
+int main()
+{
+	bool ok = true;
+	// the last code point of each encoding length and the first of the next one, the surrogates and the last code point
+	const std::vector<std::pair<char32_t, char32_t>> ranges{
+		{0x7F, 0x80}, {0x7E, 0x8F}, {0x7FF, 0x800}, {0x700, 0x8FF}, {0xFFFF, 0x10000}, {0xF000, 0x10FFF}, {0x10FFFF, 0x10FFFF},
+		{0x10FF00, 0x10FFFF}, {0xD7FF, 0xE000}, {0x7F, 0x10000}, {0x80, 0x7FF}, {0x800, 0xFFFF}, {0x10000, 0x10FFFF}, {0, 0x10FFFF}};
+	for(auto [lo, hi] : ranges)
+		ok &= check_byte_ranges(lo, hi);
+
+	const std::vector<char32_t> boundaries{0x7E, 0x7F, 0x80, 0x81, 0x7FE, 0x7FF, 0x800, 0x801, 0xD7FF, 0xE000,
+		0xFFFE, 0xFFFF, 0x10000, 0x10001, 0x10FFFE, 0x10FFFF};
+	std::vector<std::string> probes;
+	std::set<Symbol> bytes{'a', 'x', '{', '}'};
+	for(char32_t cp : boundaries)
+	{
+		probes.push_back(UTF8::encode(cp));
+		bytes.insert(probes.back().begin(), probes.back().end());
+	}
+	probes.push_back("{");
+	probes.push_back("}");
+	const std::string alphabet(bytes.begin(), bytes.end());
+	for(auto [lo, hi] : ranges)
+		if(lo > 0)
+			ok &= check_rule(name(lo, hi), "{" + UTF8::encode(lo) + "-" + UTF8::encode(hi) + "}", probes, alphabet,
+				[&](const std::string& probe) {
+					std::size_t len;
+					char32_t cp = UTF8::decode(probe, len);
+					return lo <= cp && cp <= hi;
+				});
+	// an operator after a code point of several bytes applies to the whole code point
+	ok &= check_rule("repeated code point", UTF8::encode(0x800) + "*" + UTF8::encode(0x10000), probes, alphabet,
+		[&](const std::string& probe) { return probe == UTF8::encode(0x10000); });
+	ok &= check_rule("opening brace", "{{}", probes, alphabet, [](const std::string& probe) { return probe == "{"; });
+	ok &= check_rule("closing brace", "{}}", probes, alphabet, [](const std::string& probe) { return probe == "}"; });
+	ok &= check_rule("both braces", "{}{}", probes, alphabet, [](const std::string& probe) { return probe == "{" || probe == "}"; });
+	std::cerr << (ok ? "all checks passed\n" : "some checks failed\n");
+	return ok ? 0 : 1;
+}
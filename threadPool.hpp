@@ -0,0 +1,105 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <type_traits>
+#include <utility>
+
+// Fixed set of worker threads executing tasks in the order they are submitted.
+// The destructor waits for all submitted tasks to finish. A thread which waits for the result of a task by wait runs queued tasks
+// in the meantime, so tasks may submit tasks to the same pool and wait for them without running out of workers.
+class ThreadPool
+{
+	std::mutex mutex;
+	std::condition_variable hasWork;
+	std::deque<std::move_only_function<void()>> tasks;
+	bool stopping = false;
+	std::vector<std::jthread> workers;
+
+	void work()
+	{
+		for(;;)
+		{
+			std::move_only_function<void()> task;
+			{
+				std::unique_lock lock(mutex);
+				hasWork.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if(tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+public:
+	explicit ThreadPool(std::size_t threadsCnt = std::thread::hardware_concurrency())
+	{
+		if(!threadsCnt)
+			threadsCnt = 1;
+		workers.reserve(threadsCnt);
+		for(std::size_t i = 0; i < threadsCnt; i++)
+			workers.emplace_back(&ThreadPool::work, this);
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		hasWork.notify_all();
+	}
+
+	// exceptions thrown by f are rethrown by the get() of the returned future
+	template<class F>
+	std::future<std::invoke_result_t<F>> submit(F&& f)
+	{
+		std::packaged_task<std::invoke_result_t<F>()> task(std::forward<F>(f));
+		auto result = task.get_future();
+		{
+			std::lock_guard lock(mutex);
+			tasks.emplace_back(std::move(task));
+		}
+		hasWork.notify_one();
+		return result;
+	}
+	// runs the oldest queued task on the calling thread; returns false if there is none
+	bool runPending()
+	{
+		std::move_only_function<void()> task;
+		{
+			std::lock_guard lock(mutex);
+			if(tasks.empty())
+				return false;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+		return true;
+	}
+	// Waits until future is ready, running queued tasks until then. Once none are queued, the task of future is running on another thread,
+	// and so are the tasks it waits for, so blocking cannot deadlock.
+	template<class T>
+	void wait(const std::future<T>& future)
+	{
+		while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			if(!runPending())
+			{
+				future.wait();
+				return;
+			}
+	}
+	std::size_t size() const noexcept { return workers.size(); }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef TOKENCACHE_HPP
+#define TOKENCACHE_HPP
+
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include "compiledBimachine.hpp"
+#include "outputSink.hpp"
+#include "constants.hpp"
+
+// Bounded map from tokens to their outputs which can be used from several threads at once. The tokens are spread over shards by their hash
+// and every shard has its own lock, so threads rarely wait for each other. Once a shard is full, new tokens in it are not stored;
+// in natural language the frequent tokens appear early, so they are the ones kept.
+class TokenCache
+{
+	struct Hash
+	{
+		using is_transparent = void;
+		std::size_t operator()(std::string_view token) const noexcept
+		{
+			return std::hash<std::string_view>{}(token);
+		}
+	};
+	struct alignas(64) Shard
+	{
+		mutable std::shared_mutex mutex;
+		std::unordered_map<Word, Word, Hash, std::equal_to<>> output_of;
+		std::atomic<std::uint64_t> hits{0}, misses{0};
+	};
+	std::vector<Shard> shards;
+	std::size_t shard_capacity;
+
+	Shard& shard_of(std::string_view token) noexcept
+	{
+		return shards[Hash{}(token) % shards.size()];
+	}
+public:
+	explicit TokenCache(std::size_t capacity = 1 << 16, std::size_t shards_cnt = 64):
+		shards(std::max<std::size_t>(shards_cnt, 1)), shard_capacity((capacity + shards.size() - 1) / shards.size()) {}
+
+	// appends the output for token to sink and returns true if it is stored; the lookup is counted as a hit or a miss
+	template<OutputSink Sink>
+	bool append(std::string_view token, Sink& sink)
+	{
+		Shard& shard = shard_of(token);
+		{
+			std::shared_lock lock(shard.mutex);
+			if(auto it = shard.output_of.find(token); it != shard.output_of.end())
+			{
+				sink.append(it->second);
+				shard.hits.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		shard.misses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	// stores the output for token unless its shard is full
+	void insert(std::string_view token, std::string_view output)
+	{
+		Shard& shard = shard_of(token);
+		std::unique_lock lock(shard.mutex);
+		if(shard.output_of.size() < shard_capacity)
+			shard.output_of.try_emplace(Word{token}, output);
+	}
+
+	std::size_t size() const
+	{
+		std::size_t size = 0;
+		for(const Shard& shard : shards)
+		{
+			std::shared_lock lock(shard.mutex);
+			size += shard.output_of.size();
+		}
+		return size;
+	}
+	std::uint64_t hits() const noexcept
+	{
+		std::uint64_t hits = 0;
+		for(const Shard& shard : shards)
+			hits += shard.hits.load(std::memory_order_relaxed);
+		return hits;
+	}
+	std::uint64_t misses() const noexcept
+	{
+		std::uint64_t misses = 0;
+		for(const Shard& shard : shards)
+			misses += shard.misses.load(std::memory_order_relaxed);
+		return misses;
+	}
+	double hit_rate() const noexcept
+	{
+		std::uint64_t lookups = hits() + misses();
+		return lookups ? static_cast<double>(hits()) / lookups : 0;
+	}
+};
+
+// Applies a cascade of bimachines which are local between delimiters (see CompiledBimachineWithFinalOutput::token_left_state) token by token,
+// where a token ends right after a delimiter or at the end of the input. The output for a token is taken from the cache if it is there;
+// otherwise the stages are applied on the token alone and the output is stored. The output is the same as the output of the cascade on the whole input.
+// The stages are not copied, so they must outlive the TokenwiseCascade.
+class TokenwiseCascade
+{
+	const std::vector<CompiledBimachineWithFinalOutput>& stages;
+	std::vector<State> token_left_state; // of every stage
+	std::array<bool, std::numeric_limits<USymbol>::max() + 1> is_delimiter{};
+	TokenCache cache;
+
+	// the left automata start in their initial states for the first token of the input and in token_left_state for the others
+	void apply_stages(std::string_view token, bool first, Word& output, Word& scratch, std::vector<State>& right_path) const
+	{
+		std::string_view curr = token;
+		for(std::size_t i = 0; i < stages.size(); i++)
+		{
+			Word& next = (stages.size() - 1 - i) % 2 ? scratch : output; // the last stage writes into output
+			next.clear();
+			State L = stages[i].apply_between(curr, first ? stages[i].left_initial() : token_left_state[i], stages[i].right_initial(), next, right_path);
+			stages[i].final_output(L, next);
+			curr = next;
+		}
+		if(stages.empty())
+			output = token;
+	}
+public:
+	// throws std::invalid_argument if some of the stages is not local between delimiters
+	TokenwiseCascade(const std::vector<CompiledBimachineWithFinalOutput>& stages, std::string_view delimiters, std::size_t capacity = 1 << 16):
+		stages(stages), cache(capacity)
+	{
+		for(const auto& stage : stages)
+		{
+			auto S = stage.token_left_state(delimiters);
+			if(!S)
+				throw std::invalid_argument("the bimachine at stage " + std::to_string(token_left_state.size()) + " is not local between the delimiters");
+			token_left_state.push_back(*S);
+		}
+		for(Symbol d : delimiters)
+			is_delimiter[static_cast<USymbol>(d)] = true;
+	}
+
+	// may be called from several threads at once
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink)
+	{
+		Word output, scratch;
+		std::vector<State> right_path;
+		for(std::size_t begin = 0, end; begin < input.size(); begin = end)
+		{
+			end = begin;
+			while(end < input.size() && !is_delimiter[static_cast<USymbol>(input[end])])
+				end++;
+			end = std::min(end + 1, input.size());
+			std::string_view token = input.substr(begin, end - begin);
+			if(begin == 0) // the first token is not preceded by a delimiter, so its output may differ from the cached one
+			{
+				apply_stages(token, true, output, scratch, right_path);
+				sink.append(output);
+			}
+			else if(!cache.append(token, sink))
+			{
+				apply_stages(token, false, output, scratch, right_path);
+				cache.insert(token, output);
+				sink.append(output);
+			}
+		}
+		if(input.empty())
+		{
+			apply_stages(input, true, output, scratch, right_path);
+			sink.append(output);
+		}
+	}
+	Word operator()(std::string_view input)
+	{
+		Word output;
+		output.reserve(input.size());
+		(*this)(input, output);
+		return output;
+	}
+
+	const TokenCache& Cache() const noexcept { return cache; }
+};
+
+#endif
@@ -177,16 +177,16 @@ void sortByLabel(TransitionList<LabelType>& list)
 template<>
 inline void sortByLabel(TransitionList<SymbolOrEpsilon>& list)
 {
-	list.sort(std::numeric_limits<std::make_unsigned_t<Symbol>>::max(), &Transition<SymbolOrEpsilon>::Label);
+	list.sort(std::numeric_limits<USymbol>::max(), [](const Transition<SymbolOrEpsilon>& tr) { return static_cast<USymbol>(tr.Label()); });
 }
 
 template<>
 inline void sortByLabel(TransitionList<SymbolPair>& list)
 {
-	auto trLabelSecond = [](const Transition<SymbolPair>& tr) { return tr.Label().second; };
-	list.sort(std::numeric_limits<std::make_unsigned_t<Symbol>>::max(), trLabelSecond);
-	auto trLabelFirst = [](const Transition<SymbolPair>& tr) { return tr.Label().first; };
-	list.sort(std::numeric_limits<std::make_unsigned_t<Symbol>>::max(), trLabelFirst);
+	auto trLabelSecond = [](const Transition<SymbolPair>& tr) { return static_cast<USymbol>(tr.Label().second); };
+	list.sort(std::numeric_limits<USymbol>::max(), trLabelSecond);
+	auto trLabelFirst = [](const Transition<SymbolPair>& tr) { return static_cast<USymbol>(tr.Label().first); };
+	list.sort(std::numeric_limits<USymbol>::max(), trLabelFirst);
 }
 
 template<class LabelType>
@@ -195,15 +195,15 @@ inline void sortByLabelDomain(TransitionList<LabelType>& list) = delete;
 template<>
 inline void sortByLabelDomain(TransitionList<SymbolPair>& list)
 {
-	auto trLabelFirst = [](const Transition<SymbolPair>& tr) { return tr.Label().first; };
-	list.sort(std::numeric_limits<std::make_unsigned_t<Symbol>>::max(), trLabelFirst);
+	auto trLabelFirst = [](const Transition<SymbolPair>& tr) { return static_cast<USymbol>(tr.Label().first); };
+	list.sort(std::numeric_limits<USymbol>::max(), trLabelFirst);
 }
 
 template<>
 inline void sortByLabelDomain(TransitionList<Symbol_Word>& list)
 {
-	auto trLabelFirst = [](const Transition<Symbol_Word>& tr) { return tr.Label().first; };
-	list.sort(std::numeric_limits<std::make_unsigned_t<Symbol>>::max(), trLabelFirst);
+	auto trLabelFirst = [](const Transition<Symbol_Word>& tr) { return static_cast<USymbol>(tr.Label().first); };
+	list.sort(std::numeric_limits<USymbol>::max(), trLabelFirst);
 }
 
 #endif
@@ -15,9 +15,12 @@
 #include <limits>
 #include <concepts>
 #include <functional>
+#include <string_view>
 #include "classicalFSA.hpp"
+#include "denseDFA.hpp"
 #include "contextualReplacementRule.hpp"
 #include "utilities.hpp"
+#include "outputSink.hpp"
 
 #if __has_include(<boost/unordered/unordered_flat_map.hpp>)
 #	include <boost/unordered/unordered_flat_map.hpp>
@@ -334,7 +337,7 @@ public:
 	{
 		std::size_t mu = std::numeric_limits<std::size_t>::max();
 		Word output;
-		for(const auto& tr : std::ranges::equal_range(A_T.transitions(q), letter, {}, [](const Transition<Symbol_Word>& tr) { return tr.Label().first; }))
+		for(const auto& tr : std::ranges::equal_range(A_T.transitions(q), static_cast<USymbol>(letter), {}, [](const Transition<Symbol_Word>& tr) { return static_cast<USymbol>(tr.Label().first); }))
 			if(auto it = right_state.g_inv.find(tr.To()); it != right_state.g_inv.end())
 			{
 				std::size_t ind_in_g = it->second;
@@ -360,20 +363,27 @@ public:
 
 class TwostepBimachine
 {
+	friend class CompiledTwostepBimachine;
+
 	ClassicalFSA left, right;
+	DenseDFA dense_left, dense_right; // run-optimized views of left and right
 #ifdef LIBBOOST_UNORDERED_FLAT_MAP_AVAILABLE
 	boost::unordered_flat_map<std::tuple<State, USymbol, State>, State> delta;
 	boost::unordered_flat_map<std::tuple<State, USymbol, State>, Word> psi_delta;
 	boost::unordered_flat_map<std::tuple<State, State>, State> tau;
 	boost::unordered_flat_map<std::tuple<State, State>, Word> psi_tau;
+	boost::unordered_flat_map<std::tuple<State, State>, std::uint32_t> epsilon_rule;
 #else
 	std::unordered_map<std::tuple<State, Symbol, State>, State, hash_tuple::hash<std::tuple<State, Symbol, State>>> delta;
 	std::unordered_map<std::tuple<State, Symbol, State>, Word, hash_tuple::hash<std::tuple<State, Symbol, State>>> psi_delta;
 	std::unordered_map<std::tuple<State, State>, State, hash_tuple::hash<std::tuple<State, State>>> tau;
 	std::unordered_map<std::tuple<State, State>, Word, hash_tuple::hash<std::tuple<State, State>>> psi_tau;
+	std::unordered_map<std::tuple<State, State>, std::uint32_t, hash_tuple::hash<std::tuple<State, State>>> epsilon_rule; // the rule applied on the empty word where tau is not defined, even if its output is empty
 #endif
 	State q_err;
 	std::unordered_set<State> final_center;
+	std::vector<std::uint32_t> rule_of_center; // rule_of_center[q] is the number of the rule whose center starts in q, or Constants::InvalidRule
+	std::uint32_t rules_cnt = 0;
 
 	void construct_functions(const TSBM_LeftAutomaton& left, const TSBM_RightAutomaton& right,
 							 const auto& left_classes, const auto& right_classes,
@@ -401,11 +411,12 @@ class TwostepBimachine
 			{
 				if(State init = nu(right, *rules_left_ctx_ok_ptr, *right_state_ptr); init != Constants::InvalidState)
 					tau[{left_ind, right_ind}] = init;
-				else if(std::uint32_t rule = minJ(right, batch, *rules_left_ctx_ok_ptr, *right_state_ptr);
-					rule != Constants::InvalidRule &&
-					!batch[rule].output_for_epsilon->empty() // do not insert elements which represent empty output to optimize psi_tau for size
-				)
-					psi_tau[{left_ind, right_ind}] = *batch[rule].output_for_epsilon;
+				else if(std::uint32_t rule = minJ(right, batch, *rules_left_ctx_ok_ptr, *right_state_ptr); rule != Constants::InvalidRule)
+				{
+					epsilon_rule[{left_ind, right_ind}] = rule;
+					if(!batch[rule].output_for_epsilon->empty()) // do not insert elements which represent empty output to optimize psi_tau for size
+						psi_tau[{left_ind, right_ind}] = *batch[rule].output_for_epsilon;
+				}
 			}
 		}
 	}
@@ -419,8 +430,9 @@ class TwostepBimachine
 		using psi_delta_profile_t = std::set<std::tuple<State, Symbol, Word>>;
 		using tau_profile_t = std::set<std::tuple<State, State>>; // set of (L, tau(L, R)) or set of (R, tau(L, R))
 		using psi_tau_profile_t = std::set<std::tuple<State, Word>>;
-		using left_profile_t = std::tuple<tau_profile_t, psi_tau_profile_t>;
-		using right_profile_t = std::tuple<tau_profile_t, psi_tau_profile_t, delta_profile_t, psi_delta_profile_t>;
+		using epsilon_rule_profile_t = std::set<std::tuple<State, std::uint32_t>>;
+		using left_profile_t = std::tuple<tau_profile_t, psi_tau_profile_t, epsilon_rule_profile_t>;
+		using right_profile_t = std::tuple<tau_profile_t, psi_tau_profile_t, delta_profile_t, psi_delta_profile_t, epsilon_rule_profile_t>;
 		std::vector<left_profile_t> left_profile(left_states_of_index.size());
 		std::vector<right_profile_t> right_profile(right_states_of_index.size());
 
@@ -450,6 +462,13 @@ class TwostepBimachine
 			std::get<1>(left_profile[left_index]).emplace(right_index, ret);
 		}
 
+		for(const auto& [args, ret] : epsilon_rule)
+		{
+			const auto& [left_index, right_index] = args;
+			std::get<4>(right_profile[right_index]).emplace(left_index, ret);
+			std::get<2>(left_profile[left_index]).emplace(right_index, ret);
+		}
+
 		return {
 			find_colors_helper(color_of_left, left_profile, index_of_left_state),
 			find_colors_helper(color_of_right, right_profile, index_of_right_state)
@@ -486,6 +505,7 @@ class TwostepBimachine
 		};
 		update_taulike(tau);
 		update_taulike(psi_tau);
+		update_taulike(epsilon_rule);
 	}
 	void pseudo_minimize(const std::vector<std::vector<State>>& left_states_of_index,
 						 const std::vector<std::vector<State>>& right_states_of_index,
@@ -500,12 +520,12 @@ class TwostepBimachine
 		right.transitions.sort(right.statesCnt); // same as above but for the right automaton
 		update_functions(color_of_left, color_of_right, left_states_of_index, right_states_of_index);
 	}
-	State epsilon_jump(State left, State right, Word& output) const
+	State epsilon_jump(State left, State right, OutputSink auto& sink) const
 	{
 		State curr = value_or(tau, {left, right}, q_err);
 		if(curr == q_err)
 			if(auto it = psi_tau.find({left, right}); it != psi_tau.end())
-				output += it->second;
+				sink.append(it->second);
 		return curr;
 	}
 public:
@@ -544,6 +564,10 @@ public:
 			auto right_classes = right.init_index(index_of_right_state, right_states_of_index);
 
 			q_err = right.A_T.statesCnt;
+			rules_cnt = batch.size();
+			rule_of_center.assign(q_err, Constants::InvalidRule);
+			for(auto [st, rule] : right.type_of_init_center)
+				rule_of_center[st] = rule;
 			right.A_T.transitions.sort(right.A_T.statesCnt); // needed for calling calculate_mu
 			construct_functions(left, right, left_classes, right_classes, batch);
 			for(const auto& [st, _] : right.type_of_final_center)
@@ -552,6 +576,8 @@ public:
 			this->right = std::move(right.A_R).getMFSA();
 		}
 		pseudo_minimize(left_states_of_index, right_states_of_index, index_of_left_state, index_of_right_state);
+		dense_left = DenseDFA{this->left};
+		dense_right = DenseDFA{this->right};
 
 		//debug
 		//std::cerr << "\t\tleft states: " << this->left.statesCnt << '\n';
@@ -566,31 +592,47 @@ public:
 		/*this->left.print(std::cerr << "left:\n") << '\n';
 		this->right.print(std::cerr << "right:\n") << '\n';*/
 	}
-	Word operator()(const Word& input) const
+	// right_path is scratch space; passing the same vector to successive calls avoids reallocating it
+	// the left automaton is run together with the output loop, so its path is not stored
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink, std::vector<State>& right_path) const
 	{
-		std::vector<State> left_path = left.findPath(input), right_path = right.findPath(std::views::reverse(input));
-		auto left_path_it = left_path.begin();
+		dense_right.findPath(std::views::reverse(input), right_path);
 		auto right_path_rev_it = right_path.rbegin();
 
-		Word output;
+		State left = dense_left.initial();
 		State curr/* = q_err*/;
-		curr = epsilon_jump(*left_path_it, *right_path_rev_it, output);
+		curr = epsilon_jump(left, *right_path_rev_it, sink);
 		for(Symbol s : input)
 		{
-			State left = *++left_path_it;
+			left = dense_left.successor(left, s);
 			State right = *++right_path_rev_it;
 			if(curr != q_err)
 			{
 				State next = value_or(delta, {curr, s, right}, q_err);
-				output += value_or(psi_delta, {curr, s, right}, {s});
-				curr = final_center.contains(next) ? epsilon_jump(left, right, output) : next;
+				if(auto it = psi_delta.find({curr, s, right}); it != psi_delta.end())
+					sink.append(it->second);
+				else
+					sink.push_back(s);
+				curr = final_center.contains(next) ? epsilon_jump(left, right, sink) : next;
 			}
 			else
 			{
-				output += s;
-				curr = epsilon_jump(left, right, output);
+				sink.push_back(s);
+				curr = epsilon_jump(left, right, sink);
 			}
 		}
+	}
+	template<OutputSink Sink>
+	void operator()(std::string_view input, Sink& sink) const
+	{
+		std::vector<State> right_path;
+		(*this)(input, sink, right_path);
+	}
+	Word operator()(const Word& input) const
+	{
+		Word output;
+		(*this)(std::string_view{input}, output);
 		return output;
 	}
 };
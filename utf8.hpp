@@ -0,0 +1,120 @@
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include "constants.hpp"
+
+// Encoding of code points as UTF-8 bytes, used to compile rules over code points into automata over bytes.
+namespace UTF8
+{
+	constexpr char32_t MaxCodePoint = 0x10FFFF, SurrogatesBegin = 0xD800, SurrogatesEnd = 0xDFFF;
+
+	// the number of bytes of an encoding starting with lead, or 0 if lead is not the first byte of an encoding
+	constexpr std::size_t length(USymbol lead) noexcept
+	{
+		if(lead < 0x80)
+			return 1;
+		if(lead < 0xC2)
+			return 0; // a continuation byte or the first byte of an overlong encoding
+		if(lead < 0xE0)
+			return 2;
+		if(lead < 0xF0)
+			return 3;
+		if(lead < 0xF5)
+			return 4;
+		return 0;
+	}
+	// the number of bytes of the encoding of cp
+	constexpr std::size_t length(char32_t cp) noexcept
+	{
+		return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+	}
+
+	inline std::string encode(char32_t cp)
+	{
+		if(cp > MaxCodePoint || (cp >= SurrogatesBegin && cp <= SurrogatesEnd))
+			throw std::invalid_argument("not a code point which can be encoded in UTF-8");
+		std::size_t len = length(cp);
+		if(len == 1)
+			return std::string(1, static_cast<Symbol>(cp));
+		std::string bytes(len, '\0');
+		for(std::size_t i = len; i-- > 1; cp >>= 6)
+			bytes[i] = static_cast<Symbol>(0x80 | (cp & 0x3F));
+		constexpr USymbol lead_marker[] = {0, 0, 0xC0, 0xE0, 0xF0};
+		bytes[0] = static_cast<Symbol>(lead_marker[len] | cp);
+		return bytes;
+	}
+	// decodes the code point at the start of s and sets len to the length of its encoding; throws std::invalid_argument if it is not valid UTF-8
+	inline char32_t decode(std::string_view s, std::size_t& len)
+	{
+		if(s.empty() || !(len = length(static_cast<USymbol>(s[0]))) || s.size() < len)
+			throw std::invalid_argument("invalid UTF-8");
+		char32_t cp = len == 1 ? static_cast<USymbol>(s[0]) : static_cast<USymbol>(s[0]) & (0x7F >> len);
+		for(std::size_t i = 1; i < len; i++)
+		{
+			if((static_cast<USymbol>(s[i]) & 0xC0) != 0x80)
+				throw std::invalid_argument("invalid UTF-8");
+			cp = cp << 6 | (static_cast<USymbol>(s[i]) & 0x3F);
+		}
+		if(length(cp) != len || cp > MaxCodePoint || (cp >= SurrogatesBegin && cp <= SurrogatesEnd))
+			throw std::invalid_argument("invalid UTF-8"); // overlong or not a code point
+		return cp;
+	}
+
+	// the ranges [first, second] of the bytes at each position of an encoding
+	using ByteRanges = std::vector<std::pair<USymbol, USymbol>>;
+	// Appends to sequences byte ranges whose products are exactly the encodings of the code points in [lo, hi], surrogates excluded.
+	// The range is split until lo and hi have encodings of the same length which differ only in a suffix of bytes spanning all continuation bytes,
+	// so every position ranges independently over an interval; e.g. [U+0400, U+04FF] gives [D0-D3][80-BF].
+	inline void byteRanges(char32_t lo, char32_t hi, std::vector<ByteRanges>& sequences)
+	{
+		if(lo > hi)
+			return;
+		if(hi > MaxCodePoint)
+			hi = MaxCodePoint;
+		if(lo <= SurrogatesEnd && hi >= SurrogatesBegin)
+		{
+			if(lo < SurrogatesBegin)
+				byteRanges(lo, SurrogatesBegin - 1, sequences);
+			if(hi > SurrogatesEnd)
+				byteRanges(SurrogatesEnd + 1, hi, sequences);
+			return;
+		}
+		for(char32_t last_of_length : {0x7F, 0x7FF, 0xFFFF})
+			if(lo <= last_of_length && hi > last_of_length)
+			{
+				byteRanges(lo, last_of_length, sequences);
+				byteRanges(last_of_length + 1, hi, sequences);
+				return;
+			}
+		for(std::size_t i = 1; i < length(hi); i++)
+		{
+			char32_t suffix = (char32_t{1} << 6 * i) - 1; // the bits of the last i bytes
+			if((lo & ~suffix) == (hi & ~suffix))
+				continue;
+			if(lo & suffix)
+			{
+				byteRanges(lo, lo | suffix, sequences);
+				byteRanges((lo | suffix) + 1, hi, sequences);
+				return;
+			}
+			if((hi & suffix) != suffix)
+			{
+				byteRanges(lo, (hi & ~suffix) - 1, sequences);
+				byteRanges(hi & ~suffix, hi, sequences);
+				return;
+			}
+		}
+		std::string lo_bytes = encode(lo), hi_bytes = encode(hi);
+		ByteRanges& ranges = sequences.emplace_back();
+		for(std::size_t i = 0; i < lo_bytes.size(); i++)
+			ranges.emplace_back(static_cast<USymbol>(lo_bytes[i]), static_cast<USymbol>(hi_bytes[i]));
+	}
+}
+
+#endif
@@ -104,9 +104,15 @@ struct SymbolOrEpsilon
 	{
 		return isBegin(c);
 	}
+	// the base element which reads c, as written in a regular expression
+	static std::string ofSymbol(Symbol c)
+	{
+		return std::string(1, c);
+	}
+	// symbols are ordered as unsigned bytes, as in the counting sorts of transitions by label (see sortByLabel)
 	auto operator<=>(Symbol c) const noexcept
 	{
-		return this->c <=> c;
+		return static_cast<USymbol>(this->c) <=> static_cast<USymbol>(c);
 	}
 	bool operator==(Symbol c) const noexcept
 	{
@@ -116,7 +122,10 @@ struct SymbolOrEpsilon
 	{
 		return c;
 	}
-	auto operator<=>(const SymbolOrEpsilon&) const noexcept = default;
+	auto operator<=>(const SymbolOrEpsilon& rhs) const noexcept
+	{
+		return *this <=> rhs.c;
+	}
 	bool operator==(const SymbolOrEpsilon&) const noexcept = default;
 };
 
@@ -160,6 +169,11 @@ struct WordPair
 	{
 		return c == Constants::BaseElementEnd;
 	}
+	// the base element which reads c and outputs it unchanged, as written in a regular expression
+	static std::string ofSymbol(Symbol c)
+	{
+		return {Constants::BaseElementBegin, c, Constants::BaseElementDelim, c, Constants::BaseElementEnd};
+	}
 	auto operator<=>(const WordPair&) const noexcept = default;
 	bool operator==(const WordPair&) const noexcept = default;
 